@@ -0,0 +1,29 @@
+#include "arena_t.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace data_structures {
+
+    constexpr size_t arena_t::FIRST_BLOCK_SIZE;
+    constexpr size_t arena_t::MAX_BLOCK_SIZE;
+
+    // blocks double up to MAX_BLOCK_SIZE, so small tables do not reserve much and large ones few blocks
+    void arena_t::add_block(size_t size) {
+        auto const block_size = std::max(size, next_block_size);
+        next_block_size = std::min(next_block_size * 2, MAX_BLOCK_SIZE);
+        blocks.emplace_back(new char[block_size]);
+        cursor = blocks.back().get();
+        left = block_size;
+        reserved_bytes += block_size;
+    }
+
+    boost::string_view arena_t::copy(boost::string_view text) {
+        if (text.empty()) {
+            return boost::string_view();
+        }
+        auto const chars = static_cast<char*>(allocate(text.size(), 1));
+        std::memcpy(chars, text.data(), text.size());
+        return boost::string_view(chars, text.size());
+    }
+}
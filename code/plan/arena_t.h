@@ -0,0 +1,79 @@
+#ifndef PLANNER_ARENA_T_H
+#define PLANNER_ARENA_T_H
+
+#include <boost/utility/string_view.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace data_structures {
+
+    // Monotonic allocator: memory is taken from large blocks by bumping a pointer and is only given back when
+    // the arena is destroyed. Destructors never run, so only trivially destructible types are accepted and
+    // freeing everything costs one delete per block
+    class arena_t {
+        static constexpr size_t FIRST_BLOCK_SIZE = 4 * 1024;
+        static constexpr size_t MAX_BLOCK_SIZE = 1024 * 1024;
+
+        std::vector<std::unique_ptr<char[]>> blocks;
+        char* cursor = nullptr;
+        size_t left = 0;
+        size_t next_block_size = FIRST_BLOCK_SIZE;
+        size_t used_bytes = 0;
+        size_t reserved_bytes = 0;
+
+        void add_block(size_t size);
+
+    public:
+        void* allocate(size_t size, size_t alignment) {
+            auto const padding = (alignment - reinterpret_cast<uintptr_t>(cursor) % alignment) % alignment;
+            if (size + padding > left) {
+                add_block(size + alignment);
+                return allocate(size, alignment);
+            }
+            auto const result = cursor + padding;
+            cursor += size + padding;
+            left -= size + padding;
+            used_bytes += size + padding;
+            return result;
+        }
+
+        template<typename T, typename... args_t>
+        T* create(args_t&&... args) {
+            static_assert(std::is_trivially_destructible<T>::value, "arena never runs destructors");
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<args_t>(args)...);
+        }
+
+        // value initialized array of count elements
+        template<typename T>
+        T* create_array(size_t count) {
+            static_assert(std::is_trivially_destructible<T>::value, "arena never runs destructors");
+            auto const items = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+            for (size_t i = 0 ; i < count ; ++i) {
+                new (items + i) T();
+            }
+            return items;
+        }
+
+        // copy of the text that lives as long as the arena
+        boost::string_view copy(boost::string_view text);
+
+        // bytes handed out, including alignment padding
+        size_t used() const {
+            return used_bytes;
+        }
+
+        // bytes of all blocks, what the arena really occupies
+        size_t reserved() const {
+            return reserved_bytes;
+        }
+    };
+
+}
+
+#endif //PLANNER_ARENA_T_H
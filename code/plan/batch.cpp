@@ -0,0 +1,192 @@
+#include "batch.h"
+#include "csv.h"
+#include "output_t.h"
+#include "query_stats_t.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace ds = data_structures;
+
+namespace {
+    using clock_type = std::chrono::steady_clock;
+
+    struct query_t {
+        std::string start;
+        std::string finish;
+        std::string departure;
+    };
+
+    std::vector<query_t> read_queries(std::string const& path) {
+        io::CSVReader<3, io::trim_chars<' '>, io::double_quote_escape<',', '\"'>> reader(path);
+        reader.read_header(io::ignore_extra_column, "start", "finish", "departure");
+        std::vector<query_t> queries;
+        query_t query;
+        while (reader.read_row(query.start, query.finish, query.departure)) {
+            queries.push_back(query);
+        }
+        return queries;
+    }
+
+    std::string format_time(ds::date_time_t const& time) {
+        auto text = boost::posix_time::to_iso_extended_string(time);
+        std::replace(text.begin(), text.end(), 'T', ' ');
+        return text;
+    }
+
+    void append_csv(std::string& out, std::string const& field) {
+        if (field.find_first_of(",\"\n") == std::string::npos) {
+            out += field;
+            return;
+        }
+        out += '"';
+        for (auto c : field) {
+            if (c == '"') {
+                out += '"';
+            }
+            out += c;
+        }
+        out += '"';
+    }
+
+    // one line of output: start, finish, departure, arrival, trips, legs and error, empty fields when not found
+    std::string answer(processing::map_graph_t const& map, processing::query_context_t& context,
+            query_t const& query, util::batch_format_t format, processing::engine_t engine) {
+        std::string arrival, trips, legs, error;
+        try {
+            auto const path = map.journey(query.start, query.finish,
+                    boost::posix_time::time_from_string(query.departure), context, engine);
+            arrival = format_time(path.back().arrival);
+            trips = std::to_string(processing::count_trips(map.get_timetable(), path));
+            legs = std::to_string(path.size());
+        } catch (std::exception const& e) {
+            error = e.what();
+        }
+        std::string line;
+        if (format == util::batch_format_t::csv) {
+            std::string const* fields[] = {
+                    &query.start, &query.finish, &query.departure, &arrival, &trips, &legs, &error};
+            for (auto field : fields) {
+                append_csv(line, *field);
+                line += ',';
+            }
+            line.back() = '\n';
+            return line;
+        }
+        line += "{\"start\":";
+        util::append_json(line, query.start);
+        line += ",\"finish\":";
+        util::append_json(line, query.finish);
+        line += ",\"departure\":";
+        util::append_json(line, query.departure);
+        if (error.empty()) {
+            line += ",\"arrival\":";
+            util::append_json(line, arrival);
+            line += ",\"trips\":" + trips + ",\"legs\":" + legs;
+        } else {
+            line += ",\"error\":";
+            util::append_json(line, error);
+        }
+        line += "}\n";
+        return line;
+    }
+}
+
+namespace util {
+    batch_format_t batch_format_from_string(std::string const& name) {
+        if (name == "csv") {
+            return batch_format_t::csv;
+        }
+        if (name == "json") {
+            return batch_format_t::json;
+        }
+        throw std::runtime_error("Unknown output format: " + name);
+    }
+
+    void run_batch(processing::map_graph_t const& map, std::string const& queries_path,
+            std::string const& output_path, batch_format_t format, unsigned threads, processing::engine_t engine) {
+        auto const queries = read_queries(queries_path);
+        std::vector<std::string> lines(queries.size());
+        std::vector<double> latencies(queries.size());
+
+        // queries are handed out one at a time, so slow ones do not leave a thread with a long tail of work
+        std::atomic<size_t> next_query(0);
+        auto work = [&]() {
+            processing::query_context_t context;
+            for (auto i = next_query++ ; i < queries.size() ; i = next_query++) {
+                auto const started = clock_type::now();
+                lines[i] = answer(map, context, queries[i], format, engine);
+                latencies[i] = std::chrono::duration<double, std::milli>(clock_type::now() - started).count();
+            }
+        };
+        auto const started = clock_type::now();
+        std::vector<std::thread> workers;
+        for (unsigned i = 1 ; i < threads ; ++i) {
+            workers.emplace_back(work);
+        }
+        work();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        auto const elapsed = std::chrono::duration<double>(clock_type::now() - started).count();
+
+        output_t output(output_path);
+        if (format == batch_format_t::csv) {
+            output.stream() << "start,finish,departure,arrival,trips,legs,error\n";
+        }
+        for (auto const& line : lines) {
+            output.stream() << line;
+        }
+        output.close();
+
+        std::sort(latencies.begin(), latencies.end());
+        std::cerr << queries.size() << " queries in " << elapsed << " s on " << std::max(threads, 1u)
+                  << " threads: " << (elapsed > 0 ? queries.size() / elapsed : 0) << " queries/s, p50 "
+                  << processing::percentile(latencies, 0.5) << " ms, p99 " << processing::percentile(latencies, 0.99)
+                  << " ms" << std::endl;
+    }
+}
+
+namespace util {
+    void write_isochrone(processing::map_graph_t const& map, std::string const& start, std::string const& departure,
+            unsigned step_minutes, std::string const& output_path, processing::engine_t engine) {
+        auto const departure_time = boost::posix_time::time_from_string(departure);
+        auto const started = clock_type::now();
+        auto const arrivals = map.earliest_arrivals(start, departure_time, engine);
+        auto const elapsed = std::chrono::duration<double, std::milli>(clock_type::now() - started).count();
+
+        auto const& timetable = map.get_timetable();
+        std::vector<uint32_t> reached;
+        for (uint32_t stop = 0 ; stop < arrivals.size() ; ++stop) {
+            if (!arrivals[stop].is_not_a_date_time()) {
+                reached.push_back(stop);
+            }
+        }
+        std::stable_sort(reached.begin(), reached.end(), [&](uint32_t l, uint32_t r) {
+            return arrivals[l] < arrivals[r];
+        });
+
+        auto const step = std::max(step_minutes, 1u);
+        output_t output(output_path);
+        auto& out = output.stream();
+        out << "stop_id,stop_name,stop_lat,stop_lon,arrival,minutes,band\n";
+        std::string line;
+        for (auto stop : reached) {
+            auto const minutes = (arrivals[stop] - departure_time).total_seconds() / 60;
+            line.clear();
+            append_csv(line, timetable.stop_ids[stop].to_string());
+            line += ',';
+            append_csv(line, timetable.stop_names[stop].to_string());
+            out << line << ',' << timetable.stop_latitudes[stop] << ',' << timetable.stop_longitudes[stop] << ','
+                << format_time(arrivals[stop]) << ',' << minutes << ',' << (minutes / step + 1) * step << '\n';
+        }
+        output.close();
+        std::cerr << reached.size() << " of " << arrivals.size() << " stops reached in " << elapsed << " ms"
+                  << std::endl;
+    }
+}
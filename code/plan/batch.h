@@ -0,0 +1,30 @@
+#ifndef PLANNER_BATCH_H
+#define PLANNER_BATCH_H
+
+#include "map_graph_t.h"
+
+#include <string>
+
+namespace util {
+
+enum class batch_format_t {
+    csv,
+    json
+};
+
+batch_format_t batch_format_from_string(std::string const& name);
+
+// Routes every row of a csv file with start, finish and departure columns on a pool of threads and writes one
+// result per row, in the order of the file, as csv or json lines; '-' writes to standard output. Throughput and
+// latency percentiles go to standard error at the end
+void run_batch(processing::map_graph_t const& map, std::string const& queries_path, std::string const& output_path,
+        batch_format_t format, unsigned threads, processing::engine_t engine);
+
+// Earliest arrival at every reachable stop from start as csv rows of stop id, name, position, arrival, travel
+// minutes and the band of step minutes the stop falls in, sorted by arrival; '-' writes to standard output
+void write_isochrone(processing::map_graph_t const& map, std::string const& start, std::string const& departure,
+        unsigned step_minutes, std::string const& output_path, processing::engine_t engine);
+
+} // util
+
+#endif //PLANNER_BATCH_H
@@ -0,0 +1,157 @@
+#include "csa_t.h"
+
+#include <algorithm>
+#include <exception>
+#include <tuple>
+
+namespace ds = data_structures;
+
+namespace processing {
+
+    csa_t::csa_t(ds::timetable_t const& timetable) : max_day_span(0) {
+        for (uint32_t trip = 0 ; trip < timetable.trip_count() ; ++trip) {
+            auto const end = timetable.trip_stop_times_begin[trip + 1];
+            for (auto stop_time = timetable.trip_stop_times_begin[trip] ; stop_time + 1 < end ; ++stop_time) {
+                auto const departure = timetable.stop_time_departures[stop_time];
+                max_day_span = std::max(max_day_span, departure / ds::DAY_SECONDS);
+                connections.push_back(connection_t{departure, timetable.stop_time_arrivals[stop_time + 1],
+                        timetable.stop_time_stops[stop_time], timetable.stop_time_stops[stop_time + 1], trip,
+                        stop_time});
+            }
+        }
+        // connections of a trip may share a departure when they take no time, they have to stay in trip order
+        std::sort(connections.begin(), connections.end(), [](connection_t const& l, connection_t const& r) {
+            return std::tie(l.departure, l.arrival, l.stop_time) < std::tie(r.departure, r.arrival, r.stop_time);
+        });
+    }
+
+    // Service days are merged by the scan: every day from the first one whose trips may still run at the departure
+    // has a cursor into the connections, and the cursor with the earliest absolute departure goes next. Like the
+    // other engines a trip is only boarded on the service day of the stop or the day after it, so the scan ends
+    // when no trip of those days is left even without a target
+    void csa_t::scan(ds::timetable_t const& timetable, uint32_t source, uint32_t target, int32_t query_day_number,
+            ds::seconds_t departure, query_context_t::csa_state_t& context) const {
+        auto const today = ds::day_offset(departure);
+        context.reset(timetable, today - max_day_span);
+        auto& arrivals = context.arrivals;
+        auto& labels = context.labels;
+        auto& walks = context.walks;
+        auto& cursors = context.cursors;
+        auto last_day = today;
+
+        auto reach = [&](uint32_t stop, ds::seconds_t time, csa_label_t const& label) {
+            if (time >= arrivals[stop]) {
+                return;
+            }
+            arrivals.set(stop) = time;
+            labels.set(stop) = label;
+            last_day = std::max(last_day, ds::day_offset(time));
+            walks.push_back(stop);
+            while (!walks.empty()) {
+                auto const from = walks.back();
+                walks.pop_back();
+                for (auto transfer = timetable.stop_transfers_begin[from] ;
+                        transfer < timetable.stop_transfers_begin[from + 1] ; ++transfer) {
+                    auto const to = timetable.transfer_targets[transfer];
+                    auto const walked = arrivals[from] + timetable.transfer_durations[transfer];
+                    if (walked < arrivals[to]) {
+                        arrivals.set(to) = walked;
+                        labels.set(to) = csa_label_t{from, ds::NO_INDEX, transfer};
+                        last_day = std::max(last_day, ds::day_offset(walked));
+                        walks.push_back(to);
+                    }
+                }
+            }
+        };
+
+        auto open_day = [&](int32_t day, ds::seconds_t time) {
+            auto const local = time - day * ds::DAY_SECONDS;
+            auto const first = std::lower_bound(connections.cbegin(), connections.cend(), local,
+                    [](connection_t const& l, ds::seconds_t r) {
+                        return l.departure < r;
+                    });
+            cursors.emplace_back(day, static_cast<size_t>(first - connections.cbegin()));
+            context.open_day(day);
+        };
+
+        reach(source, departure, csa_label_t());
+        for (auto day = context.first_day ; day <= today + 1 ; ++day) {
+            open_day(day, departure);
+        }
+        while (true) {
+            auto next = cursors.end();
+            auto time = INFINITE_TIME;
+            for (auto cursor = cursors.begin() ; cursor != cursors.end() ; ++cursor) {
+                if (cursor->second < connections.size()) {
+                    auto const candidate = cursor->first * ds::DAY_SECONDS + connections[cursor->second].departure;
+                    if (candidate < time) {
+                        time = candidate;
+                        next = cursor;
+                    }
+                }
+            }
+            if (next == cursors.end() || (target != ds::NO_INDEX && time >= arrivals[target])
+                    || time >= (last_day + max_day_span + 2) * ds::DAY_SECONDS) {
+                break;
+            }
+            auto const day = next->first;
+            auto const index = next->second++;
+            auto const& connection = connections[index];
+            auto entry = context.trip_entry(connection.trip, day);
+            if (entry == ds::NO_INDEX) {
+                auto const arrival = arrivals[connection.from];
+                if (arrival > time || day > ds::day_offset(arrival) + 1
+                        || !timetable.is_service_active(timetable.trip_services[connection.trip],
+                                query_day_number + day)) {
+                    continue;
+                }
+                entry = static_cast<uint32_t>(index);
+                context.board(connection.trip, day, entry);
+            }
+            reach(connection.to, day * ds::DAY_SECONDS + connection.arrival,
+                    csa_label_t{connections[entry].from, static_cast<uint32_t>(index), ds::NO_INDEX});
+            // a later arrival lets trips of the following service day be boarded
+            while (cursors.back().first < last_day + 1) {
+                open_day(cursors.back().first + 1, time);
+            }
+        }
+    }
+
+    std::vector<ds::path_leg_t> csa_t::journey(ds::timetable_t const& timetable, uint32_t source, uint32_t target,
+            ds::date_time_t const& departure, query_context_t::csa_state_t& context) const {
+        auto const query_day = departure.date();
+        scan(timetable, source, target, static_cast<int32_t>(query_day.day_number()),
+                ds::seconds_since(query_day, departure), context);
+        if (context.arrivals[target] == INFINITE_TIME) {
+            throw std::runtime_error("Unable to find connection");
+        }
+        std::vector<ds::path_leg_t> legs;
+        for (auto stop = target ; stop != ds::NO_INDEX ; stop = context.labels[stop].from) {
+            auto const& label = context.labels[stop];
+            ds::path_leg_t leg;
+            leg.arrival = ds::to_date_time(query_day, context.arrivals[stop]);
+            leg.stop = stop;
+            if (label.exit != ds::NO_INDEX) {
+                leg.transport = connections[label.exit].stop_time + 1;
+            }
+            leg.transfer = label.transfer;
+            legs.push_back(leg);
+        }
+        std::reverse(legs.begin(), legs.end());
+        return legs;
+    }
+
+    std::vector<ds::date_time_t> csa_t::earliest_arrivals(ds::timetable_t const& timetable, uint32_t source,
+            ds::date_time_t const& departure, query_context_t::csa_state_t& context) const {
+        auto const query_day = departure.date();
+        scan(timetable, source, ds::NO_INDEX, static_cast<int32_t>(query_day.day_number()),
+                ds::seconds_since(query_day, departure), context);
+        std::vector<ds::date_time_t> arrivals(timetable.stop_count(), boost::posix_time::not_a_date_time);
+        for (uint32_t stop = 0 ; stop < arrivals.size() ; ++stop) {
+            if (context.arrivals[stop] != INFINITE_TIME) {
+                arrivals[stop] = ds::to_date_time(query_day, context.arrivals[stop]);
+            }
+        }
+        return arrivals;
+    }
+}
@@ -0,0 +1,53 @@
+#ifndef PLANNER_CSA_T_H
+#define PLANNER_CSA_T_H
+
+#include "query_context_t.h"
+#include "timetable_t.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace processing {
+
+    // Connection Scan router. Every pair of consecutive stop times of a trip is an elementary connection; all
+    // of them sit in one array sorted by departure, and a query is a single pass over it from the departure
+    // time on, ending as soon as connections leave after the arrival at the target.
+    class csa_t {
+        struct connection_t {
+            data_structures::seconds_t departure;
+            data_structures::seconds_t arrival;
+            uint32_t from;
+            uint32_t to;
+            uint32_t trip;
+            uint32_t stop_time; // departure stop time, the arrival is the next one
+        };
+
+        std::vector<connection_t> connections;
+        int32_t max_day_span;
+
+        // scans on a reset context, target may be NO_INDEX to reach every stop. Times are seconds since midnight
+        // of the query day, results stay in the context
+        void scan(data_structures::timetable_t const& timetable, uint32_t source, uint32_t target,
+                int32_t query_day_number, data_structures::seconds_t departure,
+                query_context_t::csa_state_t& context) const;
+    public:
+        explicit csa_t(data_structures::timetable_t const& timetable);
+
+        std::vector<data_structures::path_leg_t> journey(
+                data_structures::timetable_t const& timetable,
+                uint32_t source,
+                uint32_t target,
+                data_structures::date_time_t const& departure,
+                query_context_t::csa_state_t& context) const;
+
+        // earliest arrival at every stop, not_a_date_time for stops that can not be reached
+        std::vector<data_structures::date_time_t> earliest_arrivals(
+                data_structures::timetable_t const& timetable,
+                uint32_t source,
+                data_structures::date_time_t const& departure,
+                query_context_t::csa_state_t& context) const;
+    };
+
+}
+
+#endif //PLANNER_CSA_T_H
@@ -48,8 +48,206 @@
 #include <cassert>
 #include <cerrno>
 #include <istream>
+#include <cstdint>
+#if !defined(CSV_IO_NO_MMAP) && (defined(__unix__) || defined(__APPLE__))
+#define CSV_IO_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if !defined(CSV_IO_NO_SIMD) && defined(__GNUC__) && defined(__SSE2__)
+#define CSV_IO_SIMD
+#include <immintrin.h>
+#endif
 
 namespace io{
+        ////////////////////////////////////////////////////////////////////////////
+        //                                 Scanning                               //
+        ////////////////////////////////////////////////////////////////////////////
+
+        // Line ends are searched for 16 bytes at a time with SSE2 or 32 bytes at a time when the cpu has
+        // AVX2, column ends of a line are found from one 64 byte window of SSE2 compares. Without SSE2 or
+        // with CSV_IO_NO_SIMD defined bytes are compared one by one.
+
+        namespace detail{
+                template<char ... char_list>
+                struct char_set;
+
+                template<>
+                struct char_set<>{
+                        static bool contains(char){
+                                return false;
+                        }
+
+                        #ifdef CSV_IO_SIMD
+                        static int match(__m128i){
+                                return 0;
+                        }
+                        #endif
+                };
+
+                template<char c, char ... other_char_list>
+                struct char_set<c, other_char_list...>{
+                        static bool contains(char x){
+                                return x == c || char_set<other_char_list...>::contains(x);
+                        }
+
+                        #ifdef CSV_IO_SIMD
+                        // one bit per byte of block equal to a char of the set
+                        static int match(__m128i block){
+                                return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_set1_epi8(c)))
+                                        | char_set<other_char_list...>::match(block);
+                        }
+                        #endif
+                };
+
+                // Finds the column ends of one line in windows of 64 bytes. A window is scanned before the
+                // columns in it are terminated, so its loads do not wait for those stores, and the columns
+                // in it are chopped without another load. candidate_chars are the chars the quote policy
+                // looks at besides the terminating '\0'. line_end is one past that '\0', no byte outside
+                // the line is read, other threads may be writing next to it.
+                template<class candidate_chars>
+                class column_end_scanner{
+                public:
+                        column_end_scanner(const char*line, const char*line_end){
+                                #ifdef CSV_IO_SIMD
+                                lower = line;
+                                upper = line_end;
+                                scan(line);
+                                #else
+                                (void)line;
+                                (void)line_end;
+                                #endif
+                        }
+
+                        // the first candidate or '\0' at or after str, str must not go back
+                        const char*next(const char*str){
+                                #ifdef CSV_IO_SIMD
+                                for(;;){
+                                        std::size_t offset = str - window;
+                                        if(offset >= 64){
+                                                scan(str);
+                                                offset = str - window;
+                                        }
+                                        const std::uint64_t candidates = mask & (~std::uint64_t(0) << offset);
+                                        if(candidates != 0)
+                                                return window + __builtin_ctzll(candidates);
+                                        str = window + 64;
+                                }
+                                #else
+                                while(*str != '\0' && !candidate_chars::contains(*str))
+                                        ++str;
+                                return str;
+                                #endif
+                        }
+
+                private:
+                        #ifdef CSV_IO_SIMD
+                        // The 16 byte block at address, bytes outside the line read as '\0'. Blocks inside the
+                        // line are loaded, the ones it starts or ends in are copied.
+                        static unsigned block_mask(__m128i block){
+                                return _mm_movemask_epi8(_mm_cmpeq_epi8(block, _mm_setzero_si128()))
+                                        | candidate_chars::match(block);
+                        }
+
+                        // the candidates and '\0's of the aligned 16 byte block at address, bytes outside the line
+                        // left out. A block across a line edge is loaded unaligned from inside the line and its
+                        // mask shifted into place, only lines shorter than a block are copied
+                        unsigned block_mask(const char*address)const{
+                                if(address >= lower && upper - address >= 16)
+                                        return block_mask(_mm_load_si128(reinterpret_cast<const __m128i*>(address)));
+                                if(upper - lower >= 16){
+                                        if(address < lower){
+                                                const __m128i*first = reinterpret_cast<const __m128i*>(lower);
+                                                return (block_mask(_mm_loadu_si128(first)) << (lower - address)) & 0xFFFF;
+                                        }
+                                        const __m128i*last = reinterpret_cast<const __m128i*>(upper - 16);
+                                        return block_mask(_mm_loadu_si128(last)) >> (address - (upper - 16));
+                                }
+                                alignas(16) char copy[16] = {};
+                                const char*begin = address < lower ? lower : address;
+                                const char*end = upper - address < 16 ? upper : address + 16;
+                                if(begin < end)
+                                        std::memcpy(copy + (begin - address), begin, end - begin);
+                                return block_mask(_mm_load_si128(reinterpret_cast<const __m128i*>(copy)))
+                                        & (0xFFFF >> (address + 16 - end)) & (0xFFFF << (begin - address));
+                        }
+
+                        // the window of the 16 byte block of str, up to the block with the line end. Bytes in
+                        // front of str are left out
+                        void scan(const char*str){
+                                const std::size_t offset = reinterpret_cast<std::uintptr_t>(str) & 15;
+                                window = str - offset;
+                                mask = 0;
+                                unsigned valid = ~0u << offset;
+                                for(int i = 0; i < 4; ++i){
+                                        const char*block = window + 16*i;
+                                        mask |= std::uint64_t(block_mask(block) & valid) << 16*i;
+                                        if(upper - block <= 16)
+                                                break;
+                                        valid = ~0u;
+                                }
+                        }
+
+                        const char*lower;
+                        const char*upper;
+                        const char*window;
+                        std::uint64_t mask;
+                        #endif
+                };
+
+                inline const char*find_line_end_bytewise(const char*begin, const char*end){
+                        while(begin != end && *begin != '\n')
+                                ++begin;
+                        return begin;
+                }
+
+                #ifdef CSV_IO_SIMD
+                inline const char*find_line_end_sse2(const char*begin, const char*end){
+                        const __m128i newline = _mm_set1_epi8('\n');
+                        for(; end - begin >= 16; begin += 16){
+                                int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin)), newline));
+                                if(mask != 0)
+                                        return begin + __builtin_ctz(mask);
+                        }
+                        return find_line_end_bytewise(begin, end);
+                }
+
+                __attribute__((target("avx2")))
+                inline const char*find_line_end_avx2(const char*begin, const char*end){
+                        const __m256i newline = _mm256_set1_epi8('\n');
+                        for(; end - begin >= 32; begin += 32){
+                                unsigned mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                                        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin)), newline));
+                                if(mask != 0)
+                                        return begin + __builtin_ctz(mask);
+                        }
+                        return find_line_end_sse2(begin, end);
+                }
+                #endif
+
+                typedef const char*(*line_end_finder)(const char*, const char*);
+
+                inline line_end_finder select_line_end_finder(){
+                        #ifdef CSV_IO_SIMD
+                        __builtin_cpu_init();
+                        if(__builtin_cpu_supports("avx2"))
+                                return find_line_end_avx2;
+                        return find_line_end_sse2;
+                        #else
+                        return find_line_end_bytewise;
+                        #endif
+                }
+
+                // The first '\n' in [begin, end) or end. The implementation is picked once for the cpu.
+                inline const char*find_line_end(const char*begin, const char*end){
+                        static const line_end_finder finder = select_line_end_finder();
+                        return finder(begin, end);
+                }
+        }
+
         ////////////////////////////////////////////////////////////////////////////
         //                                 LineReader                             //
         ////////////////////////////////////////////////////////////////////////////
@@ -315,6 +513,83 @@ namespace io{
                 };
         }
 
+        #ifdef CSV_IO_MMAP
+        // A whole file mapped copy on write, so a LineReader terminates its lines in place without a
+        // buffer and without changing the file. A zero byte follows the data, so even a last line without
+        // a newline can be terminated. The kernel is told the file is read front to back.
+        class MappedFile{
+        public:
+                MappedFile() = delete;
+                MappedFile(const MappedFile&) = delete;
+                MappedFile&operator=(const MappedFile&) = delete;
+
+                explicit MappedFile(const char*file_name){
+                        map(file_name);
+                }
+
+                explicit MappedFile(const std::string&file_name){
+                        map(file_name.c_str());
+                }
+
+                char*data(){
+                        return begin;
+                }
+
+                std::size_t size()const{
+                        return byte_count;
+                }
+
+                ~MappedFile(){
+                        munmap(begin, mapped_byte_count);
+                }
+
+        private:
+                static void throw_can_not_open_file(const char*file_name){
+                        int x = errno;
+                        error::can_not_open_file err;
+                        err.set_errno(x);
+                        err.set_file_name(file_name);
+                        throw err;
+                }
+
+                // zeroed pages for the data and the byte after it, the file is mapped over their front
+                void map(const char*file_name){
+                        int file = ::open(file_name, O_RDONLY);
+                        if(file == -1)
+                                throw_can_not_open_file(file_name);
+                        struct stat status;
+                        if(::fstat(file, &status) == -1){
+                                int x = errno;
+                                ::close(file);
+                                errno = x;
+                                throw_can_not_open_file(file_name);
+                        }
+                        byte_count = status.st_size;
+                        const std::size_t page_size = ::sysconf(_SC_PAGESIZE);
+                        mapped_byte_count = (byte_count + 1 + page_size - 1) / page_size * page_size;
+                        void*pages = ::mmap(nullptr, mapped_byte_count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                        if(pages != MAP_FAILED && byte_count != 0
+                                && ::mmap(pages, byte_count, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, file, 0) == MAP_FAILED){
+                                int x = errno;
+                                ::munmap(pages, mapped_byte_count);
+                                errno = x;
+                                pages = MAP_FAILED;
+                        }
+                        int x = errno;
+                        ::close(file);
+                        errno = x;
+                        if(pages == MAP_FAILED)
+                                throw_can_not_open_file(file_name);
+                        begin = static_cast<char*>(pages);
+                        ::madvise(begin, byte_count, MADV_SEQUENTIAL);
+                }
+
+                char*begin;
+                std::size_t byte_count;
+                std::size_t mapped_byte_count;
+        };
+        #endif
+
         class LineReader{
         private:
                 static const int block_len = 1<<24;
@@ -329,6 +604,25 @@ namespace io{
 
                 char file_name[error::max_file_name_length+1];
                 unsigned file_line;
+                const char*last_line_end;
+
+                #ifdef CSV_IO_MMAP
+                // lines are handed out from [mapped_begin, mapped_end) of the mapping when it is set, after
+                // the header line in buffer when header_pending
+                std::shared_ptr<MappedFile>mapping;
+                char*mapped_begin;
+                char*mapped_end;
+                bool header_pending;
+
+                // Terminating the lines copies the pages of the mapping. They are copied a chunk ahead of
+                // the lines in one go and dropped a chunk behind them, so a big file is not resident as a
+                // whole. Both only touch whole pages of the range, the pages at its edges are shared with
+                // the neighbouring ranges other threads read and are left to the page faults. Reads and
+                // writes of the lines themselves stay in the range
+                static const std::size_t mapped_chunk_len = 1<<22;
+                char*populated_end;
+                char*released_end;
+                #endif
 
                 static std::unique_ptr<ByteSourceBase> open_file(const char*file_name){
                         // We open the file in binary mode as it makes no difference under *nix
@@ -344,8 +638,98 @@ namespace io{
                         return std::unique_ptr<ByteSourceBase>(new detail::OwningStdIOByteSourceBase(file));
                 }
 
+                #ifdef CSV_IO_MMAP
+                static char*skip_utf8_bom(char*begin, char*end){
+                        if(end - begin >= 3 && begin[0] == '\xEF' && begin[1] == '\xBB' && begin[2] == '\xBF')
+                                return begin + 3;
+                        return begin;
+                }
+
+                // a range after the header line gets a copy of it, parts of one file can be read in parallel
+                void init(std::shared_ptr<MappedFile>file, char*range_begin, char*range_end){
+                        file_line = 0;
+                        last_line_end = nullptr;
+                        char*file_begin = skip_utf8_bom(file->data(), file->data() + file->size());
+                        mapped_begin = range_begin == file->data() ? file_begin : range_begin;
+                        mapped_end = range_end;
+                        header_pending = mapped_begin != file_begin;
+                        if(header_pending){
+                                char*file_end = file->data() + file->size();
+                                // bytewise, vector loads would read on into the lines another part terminates
+                                char*header_end = const_cast<char*>(detail::find_line_end_bytewise(file_begin, file_end));
+                                if(header_end != file_begin && header_end[-1] == '\r')
+                                        --header_end;
+                                buffer = std::unique_ptr<char[]>(new char[header_end - file_begin + 1]);
+                                std::memcpy(buffer.get(), file_begin, header_end - file_begin);
+                                buffer[header_end - file_begin] = '\0';
+                        }
+                        populated_end = std::min(page_ceil(range_begin), range_end);
+                        released_end = page_ceil(range_begin);
+                        mapping = std::move(file);
+                }
+
+                static char*page_floor(char*address){
+                        static const std::uintptr_t page_size = ::sysconf(_SC_PAGESIZE);
+                        return address - reinterpret_cast<std::uintptr_t>(address) % page_size;
+                }
+
+                static char*page_ceil(char*address){
+                        char*floor = page_floor(address);
+                        return floor == address ? address : page_floor(address + ::sysconf(_SC_PAGESIZE));
+                }
+
+                void move_mapped_window(char*line_begin){
+                        if(line_begin >= populated_end && populated_end != mapped_end){
+                                // populated_end stays on a page boundary until the last chunk
+                                char*chunk_begin = populated_end;
+                                populated_end = mapped_end - populated_end > std::ptrdiff_t(mapped_chunk_len)
+                                        ? populated_end + mapped_chunk_len : mapped_end;
+                                char*chunk_end = populated_end == mapped_end ? page_floor(mapped_end) : populated_end;
+                                #ifdef MADV_POPULATE_WRITE
+                                // older kernels fail, their pages are copied one by one on the first write
+                                if(chunk_end > chunk_begin)
+                                        ::madvise(chunk_begin, chunk_end - chunk_begin, MADV_POPULATE_WRITE);
+                                #else
+                                (void)chunk_end;
+                                #endif
+                        }
+                        char*release_end = page_floor(line_begin);
+                        if(release_end - released_end >= std::ptrdiff_t(mapped_chunk_len)){
+                                ::madvise(released_end, release_end - released_end, MADV_DONTNEED);
+                                released_end = release_end;
+                        }
+                }
+
+                char*next_mapped_line(){
+                        if(header_pending){
+                                header_pending = false;
+                                ++file_line;
+                                last_line_end = buffer.get() + std::strlen(buffer.get()) + 1;
+                                return buffer.get();
+                        }
+                        if(mapped_begin == mapped_end)
+                                return 0;
+
+                        ++file_line;
+
+                        char*line_begin = mapped_begin;
+                        move_mapped_window(line_begin);
+                        char*line_end = const_cast<char*>(detail::find_line_end(line_begin, mapped_end));
+                        // without a newline the last line ends on the zero byte after the file
+                        mapped_begin = line_end == mapped_end ? mapped_end : line_end + 1;
+                        *line_end = '\0';
+                        last_line_end = line_end + 1;
+
+                        // handle windows \r\n-line breaks
+                        if(line_end != line_begin && line_end[-1] == '\r')
+                                line_end[-1] = '\0';
+                        return line_begin;
+                }
+                #endif
+
                 void init(std::unique_ptr<ByteSourceBase>byte_source){
                         file_line = 0;
+                        last_line_end = nullptr;
 
                         buffer = std::unique_ptr<char[]>(new char[3*block_len]);
                         data_begin = 0;
@@ -416,6 +800,28 @@ namespace io{
                         init(std::unique_ptr<ByteSourceBase>(new detail::NonOwningIStreamByteSource(in)));
                 }
 
+                #ifdef CSV_IO_MMAP
+                // Lines straight from the mapping, without a copy, a reader thread or a line length limit
+                LineReader(const char*file_name, std::shared_ptr<MappedFile>file){
+                        set_file_name(file_name);
+                        char*data = file->data();
+                        init(std::move(file), data, data + file->size());
+                }
+
+                LineReader(const std::string&file_name, std::shared_ptr<MappedFile>file):
+                        LineReader(file_name.c_str(), std::move(file)){}
+
+                // The lines in [data_begin, data_end) of the mapping, after the header line of the file.
+                // data_begin has to start a line and data_end has to follow a newline or end the file.
+                LineReader(const char*file_name, std::shared_ptr<MappedFile>file, char*data_begin, char*data_end){
+                        set_file_name(file_name);
+                        init(std::move(file), data_begin, data_end);
+                }
+
+                LineReader(const std::string&file_name, std::shared_ptr<MappedFile>file, char*data_begin, char*data_end):
+                        LineReader(file_name.c_str(), std::move(file), data_begin, data_end){}
+                #endif
+
                 void set_file_name(const std::string&file_name){
                         set_file_name(file_name.c_str());
                 }
@@ -441,7 +847,16 @@ namespace io{
                         return file_line;
                 }
 
+                // one past the '\0' ending the line next_line returned last
+                const char*get_line_end()const{
+                        return last_line_end;
+                }
+
                 char*next_line(){
+                        #ifdef CSV_IO_MMAP
+                        if(mapping)
+                                return next_mapped_line();
+                        #endif
                         if(data_begin == data_end)
                                 return 0;
 
@@ -462,10 +877,7 @@ namespace io{
                                 }
                         }
 
-                        int line_end = data_begin;
-                        while(buffer[line_end] != '\n' && line_end != data_end){
-                                ++line_end;
-                        }
+                        int line_end = detail::find_line_end(buffer.get() + data_begin, buffer.get() + data_end) - buffer.get();
 
                         if(line_end - data_begin + 1 > block_len){
                                 error::line_length_limit_exceeded err;
@@ -489,6 +901,7 @@ namespace io{
 
                         char*ret = buffer.get() + data_begin;
                         data_begin = line_end+1;
+                        last_line_end = buffer.get() + data_begin;
                         return ret;
                 }
         };
@@ -755,12 +1168,19 @@ namespace io{
 
         template<char sep>
         struct no_quote_escape{
+                typedef detail::char_set<sep> column_end_candidates;
+
                 static const char*find_next_column_end(const char*col_begin){
                         while(*col_begin != sep && *col_begin != '\0')
                                 ++col_begin;
                         return col_begin;
                 }
 
+                // the first of column_end_candidates or '\0' after col_begin is its end
+                static const char*find_next_column_end(const char*, const char*candidate){
+                        return candidate;
+                }
+
                 static void unescape(char*&, char*&){
 
                 }
@@ -768,6 +1188,8 @@ namespace io{
 
         template<char sep, char quote>
         struct double_quote_escape{
+                typedef detail::char_set<sep, quote> column_end_candidates;
+
                 static const char*find_next_column_end(const char*col_begin){
                         while(*col_begin != sep && *col_begin != '\0')
                                 if(*col_begin != quote)
@@ -786,6 +1208,11 @@ namespace io{
                         return col_begin;      
                 }
 
+                // a quoted part goes on past the separators in it
+                static const char*find_next_column_end(const char*, const char*candidate){
+                        return *candidate == quote ? find_next_column_end(candidate) : candidate;
+                }
+
                 static void unescape(char*&col_begin, char*&col_end){
                         if(col_end - col_begin >= 2){
                                 if(*col_begin == quote && *(col_end-1) == quote){
@@ -807,6 +1234,26 @@ namespace io{
                 }
         };
 
+        // Column of the current row without a copy. It points into the line buffer of the reader and is
+        // only valid until the next call to read_row.
+        class column_view{
+        public:
+                column_view():str(""), length(0){}
+
+                column_view(const char*str, std::size_t length):str(str), length(length){}
+
+                const char*data()const{ return str; }
+                std::size_t size()const{ return length; }
+                bool empty()const{ return length == 0; }
+                const char*begin()const{ return str; }
+                const char*end()const{ return str + length; }
+                char operator[](std::size_t i)const{ return str[i]; }
+
+        private:
+                const char*str;
+                std::size_t length;
+        };
+
         struct throw_on_overflow{
                 template<class T>
                 static void on_overflow(T&){
@@ -859,23 +1306,44 @@ namespace io{
                         }
                 }
 
+                template<class quote_policy, class scanner>
+                void chop_next_column(
+                        char*&line, char*&col_begin, char*&col_end, scanner&column_ends
+                ){
+                        assert(line != nullptr);
+
+                        col_begin = line;
+                        col_end = col_begin + (quote_policy::find_next_column_end(col_begin, column_ends.next(col_begin)) - col_begin);
+
+                        if(*col_end == '\0'){
+                                line = nullptr;
+                        }else{
+                                *col_end = '\0';
+                                line = col_end + 1;
+                        }
+                }
+
                 template<class trim_policy, class quote_policy>
                 void parse_line(
                         char*line,
+                        const char*line_end,
                         char**sorted_col,
+                        char**sorted_col_end,
                         const std::vector<int>&col_order
                 ){
+                        column_end_scanner<typename quote_policy::column_end_candidates>column_ends(line, line_end);
                         for(std::size_t i=0; i<col_order.size(); ++i){
                                 if(line == nullptr)
                                         throw ::io::error::too_few_columns();
                                 char*col_begin, *col_end;
-                                chop_next_column<quote_policy>(line, col_begin, col_end);
+                                chop_next_column<quote_policy>(line, col_begin, col_end, column_ends);
 
                                 if(col_order[i] != -1){
                                         trim_policy::trim(col_begin, col_end);
                                         quote_policy::unescape(col_begin, col_end);
                                                                
                                         sorted_col[col_order[i]] = col_begin;
+                                        sorted_col_end[col_order[i]] = col_end;
                                 }
                         }
                         if(line != nullptr)
@@ -1097,7 +1565,17 @@ namespace io{
                         // "sizeof(T)!=sizeof(T)" only when instantiating it. This is why
                         // this strange construct is used.
                         static_assert(sizeof(T)!=sizeof(T),
-                                "Can not parse this type. Only buildin integrals, floats, char, char*, const char* and std::string are supported");
+                                "Can not parse this type. Only buildin integrals, floats, char, char*, const char*, std::string and column_view are supported");
+                }
+
+                template<class overflow_policy, class T>
+                void parse(char*col, char*, T&x){
+                        parse<overflow_policy>(col, x);
+                }
+
+                template<class overflow_policy>
+                void parse(char*col, char*col_end, column_view&x){
+                        x = column_view(col, col_end - col);
                 }
 
         }
@@ -1113,6 +1591,7 @@ namespace io{
                 LineReader in;
 
                 char*(row[column_count]);
+                char*row_end[column_count];
                 std::string column_names[column_count];
 
                 std::vector<int>col_order;
@@ -1134,6 +1613,7 @@ namespace io{
                 template<class ...Args>
                 explicit CSVReader(Args&&...args):in(std::forward<Args>(args)...){
                         std::fill(row, row+column_count, nullptr);
+                        std::fill(row_end, row_end+column_count, nullptr);
                         col_order.resize(column_count);
                         for(unsigned i=0; i<column_count; ++i)
                                 col_order[i] = i;
@@ -1176,6 +1656,7 @@ namespace io{
                                 "too many column names specified");
                         set_column_names(std::forward<ColNames>(cols)...);
                         std::fill(row, row+column_count, nullptr);
+                        std::fill(row_end, row_end+column_count, nullptr);
                         col_order.resize(column_count);
                         for(unsigned i=0; i<column_count; ++i)
                                 col_order[i] = i;
@@ -1216,7 +1697,7 @@ namespace io{
                         if(row[r]){
                                 try{
                                         try{
-                                                ::io::detail::parse<overflow_policy>(row[r], t);
+                                                ::io::detail::parse<overflow_policy>(row[r], row_end[r], t);
                                         }catch(error::with_column_content&err){
                                                 err.set_column_content(row[r]);
                                                 throw;
@@ -1248,7 +1729,7 @@ namespace io{
                                         }while(comment_policy::is_comment(line));
                                        
                                         detail::parse_line<trim_policy, quote_policy>
-                                                (line, row, col_order);
+                                                (line, in.get_line_end(), row, row_end, col_order);
                
                                         parse_helper(0, cols...);
                                 }catch(error::with_file_name&err){
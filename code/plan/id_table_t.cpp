@@ -0,0 +1,190 @@
+#include "id_table_t.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+    uint64_t mix(uint64_t value) {
+        value ^= value >> 33;
+        value *= 0xff51afd7ed558ccdull;
+        value ^= value >> 33;
+        value *= 0xc4ceb9fe1a85ec53ull;
+        value ^= value >> 33;
+        return value;
+    }
+
+    // eight bytes at a time, ids are short so this is mostly one or two rounds
+    uint64_t hash_id(boost::string_view id, uint64_t seed) {
+        auto hash = mix(seed * 0x9e3779b97f4a7c15ull + id.size());
+        size_t i = 0;
+        for ( ; i + sizeof(uint64_t) <= id.size() ; i += sizeof(uint64_t)) {
+            uint64_t word;
+            std::memcpy(&word, id.data() + i, sizeof(word));
+            hash = mix(hash ^ word);
+        }
+        uint64_t tail = 0;
+        std::memcpy(&tail, id.data() + i, id.size() - i);
+        return mix(hash ^ tail);
+    }
+
+    // seeds tried for one bucket before giving up, with one bucket per id a handful is enough in practice
+    constexpr int32_t MAX_SEED = 1 << 20;
+}
+
+namespace data_structures {
+
+    void id_table_t::grow() {
+        std::vector<uint32_t> grown(std::max<size_t>(slots.size() * 2, 16), NO_INDEX);
+        auto const mask = grown.size() - 1;
+        for (uint32_t handle = 0 ; handle < ids.size() ; ++handle) {
+            auto slot = hashes[handle] & mask;
+            while (grown[slot] != NO_INDEX) {
+                slot = (slot + 1) & mask;
+            }
+            grown[slot] = handle;
+        }
+        slots.swap(grown);
+    }
+
+    std::pair<uint32_t, bool> id_table_t::intern(boost::string_view id) {
+        if (frozen) {
+            throw std::logic_error("Id table is frozen: " + id.to_string());
+        }
+        auto const hash = hash_id(id, 0);
+        if ((ids.size() + 1) * 2 > slots.size()) {
+            grow();
+        }
+        auto const mask = slots.size() - 1;
+        auto slot = hash & mask;
+        while (slots[slot] != NO_INDEX) {
+            auto const handle = slots[slot];
+            if (hashes[handle] == hash && ids[handle] == id) {
+                return std::make_pair(handle, false);
+            }
+            slot = (slot + 1) & mask;
+        }
+        auto const handle = static_cast<uint32_t>(ids.size());
+        slots[slot] = handle;
+        ids.push_back(arena.copy(id));
+        hashes.push_back(hash);
+        return std::make_pair(handle, true);
+    }
+
+    size_t id_table_t::bytes() const {
+        return arena.reserved() + ids.capacity() * sizeof(ids[0]) + hashes.capacity() * sizeof(hashes[0])
+                + slots.capacity() * sizeof(slots[0]) + displacements.capacity() * sizeof(displacements[0]);
+    }
+
+    uint32_t id_table_t::find(boost::string_view id) const {
+        if (ids.empty()) {
+            return NO_INDEX;
+        }
+        auto const hash = hash_id(id, 0);
+        if (frozen) {
+            auto const displacement = displacements[hash % displacements.size()];
+            if (displacement == 0) {
+                return NO_INDEX;
+            }
+            auto const slot = displacement < 0
+                    ? static_cast<size_t>(-(displacement + 1))
+                    : hash_id(id, static_cast<uint64_t>(displacement)) % slots.size();
+            auto const handle = slots[slot];
+            return ids[handle] == id ? handle : NO_INDEX;
+        }
+        auto const mask = slots.size() - 1;
+        for (auto slot = hash & mask ; slots[slot] != NO_INDEX ; slot = (slot + 1) & mask) {
+            auto const handle = slots[slot];
+            if (hashes[handle] == hash && ids[handle] == id) {
+                return handle;
+            }
+        }
+        return NO_INDEX;
+    }
+
+    // hash and displace: ids are put into buckets by their plain hash, then starting with the largest bucket
+    // every bucket searches a seed that sends all its ids to free slots. Buckets with a single id take any
+    // free slot directly
+    void id_table_t::freeze() {
+        if (frozen) {
+            return;
+        }
+        frozen = true;
+        auto const count = ids.size();
+        if (count == 0) {
+            slots = {};
+            return;
+        }
+        std::vector<uint32_t> bucket_begin(count + 1, 0);
+        for (auto hash : hashes) {
+            ++bucket_begin[hash % count + 1];
+        }
+        for (size_t i = 1 ; i <= count ; ++i) {
+            bucket_begin[i] += bucket_begin[i - 1];
+        }
+        std::vector<uint32_t> bucket_ids(count);
+        auto fill = bucket_begin;
+        for (uint32_t handle = 0 ; handle < count ; ++handle) {
+            bucket_ids[fill[hashes[handle] % count]++] = handle;
+        }
+        // largest buckets first, bucket sizes are small so they are sorted by counting
+        std::vector<uint32_t> first_of_size;
+        for (uint32_t bucket = 0 ; bucket < count ; ++bucket) {
+            auto const size = bucket_begin[bucket + 1] - bucket_begin[bucket];
+            if (size >= first_of_size.size()) {
+                first_of_size.resize(size + 1, 0);
+            }
+            ++first_of_size[size];
+        }
+        uint32_t position = 0;
+        for (size_t size = first_of_size.size() ; size-- > 0 ; ) {
+            auto const size_count = first_of_size[size];
+            first_of_size[size] = position;
+            position += size_count;
+        }
+        std::vector<uint32_t> buckets(count);
+        for (uint32_t bucket = 0 ; bucket < count ; ++bucket) {
+            buckets[first_of_size[bucket_begin[bucket + 1] - bucket_begin[bucket]]++] = bucket;
+        }
+
+        displacements.assign(count, 0);
+        slots.assign(count, NO_INDEX);
+        std::vector<size_t> taken;
+        size_t next_free = 0;
+        for (auto bucket : buckets) {
+            auto const begin = bucket_begin[bucket];
+            auto const end = bucket_begin[bucket + 1];
+            if (end - begin == 0) {
+                break;
+            }
+            if (end - begin == 1) {
+                while (slots[next_free] != NO_INDEX) {
+                    ++next_free;
+                }
+                slots[next_free] = bucket_ids[begin];
+                displacements[bucket] = -static_cast<int32_t>(next_free) - 1;
+                continue;
+            }
+            for (int32_t seed = 1 ; ; ++seed) {
+                if (seed == MAX_SEED) {
+                    throw std::runtime_error("Unable to build perfect hash over ids");
+                }
+                taken.clear();
+                for (auto i = begin ; i < end ; ++i) {
+                    auto const slot = hash_id(ids[bucket_ids[i]], static_cast<uint64_t>(seed)) % count;
+                    if (slots[slot] != NO_INDEX || std::find(taken.begin(), taken.end(), slot) != taken.end()) {
+                        break;
+                    }
+                    taken.push_back(slot);
+                }
+                if (taken.size() == end - begin) {
+                    for (size_t i = 0 ; i < taken.size() ; ++i) {
+                        slots[taken[i]] = bucket_ids[begin + i];
+                    }
+                    displacements[bucket] = seed;
+                    break;
+                }
+            }
+        }
+        hashes = {};
+    }
+}
@@ -0,0 +1,127 @@
+#ifndef PLANNER_ID_TABLE_T_H
+#define PLANNER_ID_TABLE_T_H
+
+#include "arena_t.h"
+
+#include <boost/utility/string_view.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace data_structures {
+
+    constexpr uint32_t NO_INDEX = std::numeric_limits<uint32_t>::max();
+
+    // Interned ids. Every distinct id is copied once into an arena that never moves, so views of it stay valid
+    // as long as the table lives, and gets a dense handle in order of interning. While the table grows ids
+    // are found through an open addressing hash table; freeze replaces it by a minimal perfect hash over the
+    // final ids, every lookup after that costs one or two hashes and a single comparison.
+    class id_table_t {
+        arena_t arena;
+        std::vector<boost::string_view> ids;
+        std::vector<uint64_t> hashes;
+        // handles by slot, open addressing with linear probing before freeze, perfect hash slots after it
+        std::vector<uint32_t> slots;
+        // bucket of a frozen table: 0 when empty, -slot - 1 for a single id, otherwise the seed of its hash
+        std::vector<int32_t> displacements;
+        bool frozen = false;
+
+        void grow();
+
+    public:
+        // handle of the id, the id is added when it is not interned yet. Only valid before freeze
+        std::pair<uint32_t, bool> intern(boost::string_view id);
+
+        // NO_INDEX when the id is unknown
+        uint32_t find(boost::string_view id) const;
+
+        void freeze();
+
+        bool is_frozen() const {
+            return frozen;
+        }
+
+        boost::string_view operator[](uint32_t handle) const {
+            return ids[handle];
+        }
+
+        uint32_t size() const {
+            return static_cast<uint32_t>(ids.size());
+        }
+
+        // memory held by the arena and the lookup structures
+        size_t bytes() const;
+    };
+
+    // Entities of one feed table by their interned id, in order of insertion. The handle of an id is the
+    // position of its entry
+    template<typename T>
+    class value_by_id {
+        id_table_t table;
+        std::vector<std::pair<boost::string_view, T>> entries;
+    public:
+        using const_iterator = typename std::vector<std::pair<boost::string_view, T>>::const_iterator;
+
+        // like std::unordered_map::emplace, a repeated id keeps the first value
+        std::pair<uint32_t, bool> emplace(boost::string_view id, T value) {
+            auto const handle = table.intern(id);
+            if (handle.second) {
+                entries.emplace_back(table[handle.first], std::move(value));
+            }
+            return handle;
+        }
+
+        uint32_t find(boost::string_view id) const {
+            return table.find(id);
+        }
+
+        size_t count(boost::string_view id) const {
+            return find(id) == NO_INDEX ? 0 : 1;
+        }
+
+        T const& at(boost::string_view id) const {
+            auto const handle = find(id);
+            if (handle == NO_INDEX) {
+                throw std::out_of_range("Unknown id: " + id.to_string());
+            }
+            return entries[handle].second;
+        }
+
+        // the interned copy of the id of an entry
+        boost::string_view id(uint32_t handle) const {
+            return entries[handle].first;
+        }
+
+        T const& operator[](uint32_t handle) const {
+            return entries[handle].second;
+        }
+
+        void freeze() {
+            table.freeze();
+        }
+
+        size_t size() const {
+            return entries.size();
+        }
+
+        size_t bytes() const {
+            return table.bytes() + entries.capacity() * sizeof(entries[0]);
+        }
+
+        const_iterator begin() const {
+            return entries.cbegin();
+        }
+
+        const_iterator end() const {
+            return entries.cend();
+        }
+    };
+
+}
+
+#endif //PLANNER_ID_TABLE_T_H
@@ -0,0 +1,80 @@
+#include "load_report_t.h"
+#include "memory_usage.h"
+#include "output_t.h"
+
+#include <algorithm>
+
+namespace {
+    double milliseconds(std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    constexpr double MEGABYTE = 1024 * 1024;
+}
+
+namespace util {
+    double load_report_t::phase_t::megabytes_per_second() const {
+        if (bytes == 0 || wall == std::chrono::nanoseconds::zero()) {
+            return 0;
+        }
+        return bytes / MEGABYTE / std::chrono::duration<double>(wall).count();
+    }
+
+    load_report_t::phase_t& load_report_t::phase(std::string const& name) {
+        auto const found = std::find_if(phases.begin(), phases.end(), [&](phase_t const& phase) {
+            return phase.name == name;
+        });
+        if (found != phases.end()) {
+            return *found;
+        }
+        phases.emplace_back();
+        phases.back().name = name;
+        return phases.back();
+    }
+
+    // the parallelism is the cpu time of all parse tasks over their wall time, how many threads were busy on
+    // average. It is no speedup over a serial parse, the threads contend for memory and tasks differ in size
+    void load_report_t::print(std::ostream& out) const {
+        out << "Load report:" << std::endl;
+        for (auto const& phase : phases) {
+            out << "\t" << phase.name << ": " << milliseconds(phase.wall) << " ms";
+            if (phase.parts > 1) {
+                out << " in " << phase.parts << " parts";
+            }
+            out << ", cpu " << milliseconds(phase.cpu) << " ms";
+            if (phase.rows != 0) {
+                out << ", " << phase.rows << " rows";
+            }
+            if (phase.bytes != 0) {
+                out << ", " << phase.bytes << " bytes, " << phase.megabytes_per_second() << " MB/s";
+            }
+            if (ALLOCATION_COUNTS) {
+                out << ", " << phase.allocations << " allocations";
+            }
+            out << ", resident " << (phase.resident_growth < 0 ? "" : "+") << phase.resident_growth / 1024 << " KB"
+                    << std::endl;
+        }
+        out << "\tParse: " << milliseconds(parse_wall) << " ms on " << threads << " threads, cpu "
+                << milliseconds(parse_cpu) << " ms, parallelism "
+                << milliseconds(parse_cpu) / std::max(milliseconds(parse_wall), 1e-3) << std::endl;
+        out << "\tResident: " << resident_bytes / MEGABYTE << " MB" << std::endl;
+    }
+
+    void load_report_t::write_json(std::ostream& out) const {
+        out << "{\"threads\":" << threads << ",\"parse_ms\":" << milliseconds(parse_wall) << ",\"parse_cpu_ms\":"
+                << milliseconds(parse_cpu) << ",\"resident_bytes\":" << resident_bytes << ",\"phases\":[";
+        for (size_t i = 0 ; i < phases.size() ; ++i) {
+            auto const& phase = phases[i];
+            std::string name;
+            append_json(name, phase.name);
+            out << (i == 0 ? "" : ",") << "{\"name\":" << name << ",\"parts\":" << phase.parts << ",\"bytes\":"
+                    << phase.bytes << ",\"rows\":" << phase.rows << ",\"wall_ms\":" << milliseconds(phase.wall)
+                    << ",\"cpu_ms\":" << milliseconds(phase.cpu) << ",\"mb_per_s\":" << phase.megabytes_per_second();
+            if (ALLOCATION_COUNTS) {
+                out << ",\"allocations\":" << phase.allocations;
+            }
+            out << ",\"resident_growth_bytes\":" << phase.resident_growth << "}";
+        }
+        out << "]}" << std::endl;
+    }
+}
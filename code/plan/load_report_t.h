@@ -0,0 +1,48 @@
+#ifndef PLANNER_LOAD_REPORT_T_H
+#define PLANNER_LOAD_REPORT_T_H
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace util {
+
+    // What loading a feed took, phase by phase: a table, the sorts linking stop times to their trips or compiling
+    // the timetable. Allocations are counted on the threads running a phase, resident growth is of the whole
+    // process while the phase ran, so phases running in parallel see each other's memory
+    struct load_report_t {
+        struct phase_t {
+            std::string name;
+            size_t parts = 0; // tasks the phase ran as
+            uint64_t bytes = 0; // of the table, 0 for phases not reading one
+            uint64_t rows = 0; // of the table or the stop times handled, a table drops rows repeating an id
+            std::chrono::nanoseconds wall = std::chrono::nanoseconds::zero(); // summed over parts
+            std::chrono::nanoseconds cpu = std::chrono::nanoseconds::zero();
+            uint64_t allocations = 0; // counted with PLANNER_ALLOCATION_COUNTS only
+            int64_t resident_growth = 0; // bytes
+
+            // per thread for phases in parts, wall is their sum. 0 for phases not reading a table
+            double megabytes_per_second() const;
+        };
+
+        std::vector<phase_t> phases;
+        unsigned threads = 1;
+        // of the parse task graph, the phases after it run on their own
+        std::chrono::nanoseconds parse_wall = std::chrono::nanoseconds::zero();
+        std::chrono::nanoseconds parse_cpu = std::chrono::nanoseconds::zero();
+        size_t resident_bytes = 0; // once loaded
+
+        // added to the phase of the name, created in order of first appearance
+        phase_t& phase(std::string const& name);
+
+        void print(std::ostream& out) const;
+
+        // one object with the totals and an array of the phases
+        void write_json(std::ostream& out) const;
+    };
+
+}
+
+#endif //PLANNER_LOAD_REPORT_T_H
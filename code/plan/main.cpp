@@ -1,15 +1,80 @@
+#include "batch.h"
+#include "map_graph_t.h"
+#include "output_t.h"
 #include "parser.h"
+#include "server.h"
+#include "snapshot.h"
 
 #include <boost/program_options.hpp>
+#include <algorithm>
+#include <csignal>
+#include <cstdlib>
 #include <iostream>
 #include <exception>
+#include <thread>
 
 namespace po = boost::program_options;
 
+namespace {
+    // standard output for '-'
+    void write_load_report(util::load_report_t const& report, std::string const& path) {
+        util::output_t output(path);
+        report.write_json(output.stream());
+        output.close();
+    }
+}
+
+#ifdef PLANNER_QUERY_STATS
+namespace {
+    void print_query_stats() {
+        processing::process_query_stats().print(std::cerr);
+    }
+
+    // The query stats of the process go to standard error at exit and on every SIGUSR1. The signal is blocked
+    // before any other thread starts and taken by a thread of its own, so printing never runs in a handler
+    void report_query_stats() {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGUSR1);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        std::thread([signals]() {
+            int signal;
+            while (sigwait(&signals, &signal) == 0) {
+                print_query_stats();
+            }
+        }).detach();
+        std::atexit(print_query_stats);
+    }
+}
+#endif
+
 int main(int argc, char** argv) {
     po::options_description desc("Options");
     desc.add_options()
-            ("feed_directory", po::value<std::string>()->required(), "Enter feed directory")
+            ("feed_directory", po::value<std::string>(), "Enter feed directory")
+            ("compile", po::value<std::string>(), "Parse the feed, write the binary timetable to this file and exit")
+            ("timetable", po::value<std::string>(), "Route on a timetable written by --compile instead of a feed")
+            ("parse_threads", po::value<unsigned>()->default_value(std::max(std::thread::hardware_concurrency(), 1u)),
+                    "Threads used to parse the feed")
+            ("load_report", po::value<std::string>(),
+                    "Write the load report of the feed as JSON to this file, '-' for standard output")
+            ("trip_transfers", "Compute the trip to trip transfers of the trip_based engine while parsing")
+            ("engine", po::value<std::string>()->default_value("dijkstra"),
+                    "Routing engine: dijkstra, astar, raptor, csa or trip_based")
+            ("pareto", "Answer with every journey of the Pareto front of arrival time and transfers")
+            ("max_transfers", po::value<uint32_t>(), "Transfers allowed in Pareto answers")
+            ("serve", po::value<std::string>(), "Answer queries on this unix domain socket instead of the terminal")
+            ("threads", po::value<unsigned>()->default_value(std::max(std::thread::hardware_concurrency(), 1u)),
+                    "Threads answering queries in server and batch mode")
+            ("queries", po::value<std::string>(),
+                    "Answer every row of this csv file with start, finish and departure columns and exit")
+            ("isochrone", po::value<std::string>(), "Write the earliest arrival at every stop from this stop id and exit")
+            ("departure", po::value<std::string>(), "Departure date time of the isochrone")
+            ("isochrone_step", po::value<unsigned>()->default_value(15), "Isochrone band width in minutes")
+            ("output", po::value<std::string>()->default_value("-"),
+                    "Batch mode or isochrone results file, '-' for standard output")
+            ("output_format", po::value<std::string>()->default_value("csv"), "Batch mode results: csv or json")
+            ("stats", "Print what every query did after its answer, needs a build with PLANNER_QUERY_STATS")
             ("help", "Print help messages");
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -19,9 +84,61 @@ int main(int argc, char** argv) {
     }
     try {
         po::notify(vm);
-        auto feed_directory = vm["feed_directory"].as<std::string>();
-        std::cout << "Parsing feed" << std::endl;
-        auto map = util::parse(feed_directory);
+        auto engine = processing::engine_from_string(vm["engine"].as<std::string>());
+        util::query_options_t options;
+        options.engine = engine;
+        options.pareto = vm.count("pareto") != 0;
+        if (vm.count("max_transfers")) {
+            options.max_transfers = vm["max_transfers"].as<uint32_t>();
+        }
+        options.stats = vm.count("stats") != 0;
+#ifdef PLANNER_QUERY_STATS
+        report_query_stats();
+#else
+        if (options.stats) {
+            throw std::runtime_error("Query stats are not compiled in, build with -DPLANNER_QUERY_STATS=ON");
+        }
+#endif
+        data_structures::timetable_t timetable;
+        if (vm.count("timetable")) {
+            std::cout << "Mapping timetable" << std::endl;
+            timetable = util::load_snapshot(vm["timetable"].as<std::string>());
+        } else if (vm.count("feed_directory")) {
+            std::cout << "Parsing feed" << std::endl;
+            util::load_report_t report;
+            timetable = util::parse(vm["feed_directory"].as<std::string>(), vm["parse_threads"].as<unsigned>(),
+                    vm.count("trip_transfers") != 0, &report);
+            if (vm.count("load_report")) {
+                write_load_report(report, vm["load_report"].as<std::string>());
+            }
+        } else {
+            throw std::runtime_error("Either feed_directory or timetable is required");
+        }
+        if (vm.count("compile")) {
+            util::write_snapshot(timetable, vm["compile"].as<std::string>());
+            std::cout << "Timetable written to " << vm["compile"].as<std::string>() << std::endl;
+            return 0;
+        }
+        processing::map_graph_t map(std::move(timetable));
+        if (vm.count("isochrone")) {
+            if (!vm.count("departure")) {
+                throw std::runtime_error("Isochrone requires departure");
+            }
+            util::write_isochrone(map, vm["isochrone"].as<std::string>(), vm["departure"].as<std::string>(),
+                    vm["isochrone_step"].as<unsigned>(), vm["output"].as<std::string>(), engine);
+            return 0;
+        }
+        if (vm.count("queries")) {
+            util::run_batch(map, vm["queries"].as<std::string>(), vm["output"].as<std::string>(),
+                    util::batch_format_from_string(vm["output_format"].as<std::string>()),
+                    vm["threads"].as<unsigned>(), engine);
+            return 0;
+        }
+        if (vm.count("serve")) {
+            util::serve(map, vm["serve"].as<std::string>(), vm["threads"].as<unsigned>(), options);
+            return 0;
+        }
+        processing::query_context_t context;
         std::cout << "Enter start id than stop id and than departure date time each in separate line" << std::endl;
         std::cout << "For exit enter 'q'" << std::endl;
         while(true) {
@@ -32,22 +149,7 @@ int main(int argc, char** argv) {
             }
             std::getline(std::cin, finish);
             std::getline(std::cin, departure);
-            try {
-                for (auto const& leg : map.journey(start, finish, boost::posix_time::time_from_string(departure))) {
-                    std::cout << "Next stop: " << leg.stop->name << std::endl;
-                    std::cout << "\tDate and time: " << leg.arrival << std::endl;
-                    if (leg.transport) {
-                        std::cout << "\tArrived by " << leg.transport->trip->route->desc
-                            << " " << leg.transport->trip->route->short_name
-                            << " direction to " << leg.transport->trip->head_sign << std::endl;
-                    }
-                    if (leg.transfer) {
-                        std::cout << "\tArrived by foot. Transfer time: " << leg.transfer->duration << std::endl;
-                    }
-                }
-            } catch (std::exception const& e) {
-                std::cout << "Something wrong: " << e.what() << std::endl;
-            }
+            util::answer_query(map, context, start, finish, departure, options, std::cout);
         }
     } catch (std::exception const& e) {
         std::cerr << "Unhandled exception: " << e.what() << std::endl;
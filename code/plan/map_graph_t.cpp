@@ -1,170 +1,314 @@
 #include "map_graph_t.h"
 
 #include <exception>
-#include <queue>
-#include <deque>
 #include <algorithm>
-#include <unordered_set>
+#include <functional>
 #include <vector>
 #include <utility>
 
 namespace ds = data_structures;
 
 namespace {
-    struct list_t {
-        ds::stop_ptr stop;
-        ds::date_time_t date_time;
-        ds::stop_time_ptr stop_time;
-        ds::transfer_ptr transfer;
-        std::shared_ptr<list_t> parent;
-    };
-
-    std::vector<ds::path_leg_t> unwind(std::shared_ptr<list_t> const& list) {
-        std::deque<ds::path_leg_t> deq;
-        auto next = list;
-        while (next != nullptr) {
-            ds::path_leg_t leg;
-            leg.arrival = next->date_time;
-            leg.stop = next->stop;
-            leg.transport = next->stop_time;
-            leg.transfer = next->transfer;
-            deq.push_front(std::move(leg));
-            next = next->parent;
-        }
-        return std::vector<ds::path_leg_t>(deq.cbegin(), deq.cend());
-    }
+    using processing::query_context_t;
 
-    auto date_with_other_time(ds::date_t const& date, ds::time_t const& time) {
-        return ds::date_time_t(date, time);
+    // every thread keeps its scratch memory between queries
+    query_context_t& thread_context() {
+        thread_local query_context_t context;
+        return context;
     }
 
-    struct next_stop_t {
-        ds::stop_ptr destination;
-        ds::stop_ptr source;
-        ds::transfer_ptr transfer;
-        ds::stop_time_ptr transport;
+    using processing::query_stats_t;
 
-        next_stop_t(
-                ds::stop_ptr destination,
-                ds::stop_ptr source,
-                ds::transfer_ptr transfer,
-                ds::stop_time_ptr transport) noexcept :
-                destination(std::move(destination)),
-                source(std::move(source)),
-                transfer(std::move(transfer)),
-                transport(std::move(transport)) {
+    // adds the stats of a query to the process totals however the query ends. Engines not timing their phases
+    // spend all of the query searching
+    class stats_scope_t {
+        query_stats_t& stats;
+        query_stats_t::clock_t::time_point started;
+    public:
+        explicit stats_scope_t(query_stats_t& stats) : stats(stats), started(query_stats_t::clock_t::now()) {
+            stats.clear();
         }
 
-        bool operator<(next_stop_t const& that) const {
-            return destination->id < that.destination->id;
-        }
-    };
-
-    void add_next_stops(std::vector<std::pair<ds::date_t , ds::stop_time_ptr >>& result,
-            ds::stop_ptr const& stop, ds::date_t const& date, ds::date_time_t const& departure) {
-        auto st_cmp = [&](ds::stop_time_ptr const& l, ds::date_time_t const& r) {
-            return date_with_other_time(date, l->departure) < r;
-        };
-        for (auto it =
-                std::lower_bound(stop->stop_times.cbegin(), stop->stop_times.cend(), departure, st_cmp) ;
-             it != stop->stop_times.cend() ; ++it) {
-            auto week_day = date.day_of_week();
-            auto const& service = (*it)->trip->service;
-            if (service->week_days.count(week_day.as_enum()) == 0 && service->exceptions.count(date) == 0) {
-                continue;
+        ~stats_scope_t() {
+            if (stats.search_time == query_stats_t::clock_t::duration::zero()) {
+                stats.search_time = query_stats_t::clock_t::now() - started;
             }
-            result.emplace_back(date, *it);
+            processing::process_query_stats().add(stats);
         }
-    }
+    };
 
-    auto get_next_stops(ds::stop_ptr const& stop, ds::date_time_t const& date_time) {
-        std::vector<std::pair<ds::date_t, ds::stop_time_ptr>> result;
-        result.reserve(stop->stop_times.size() / 4 + stop->stop_times.size());
-        for (size_t i = 3 ; i > 0 ; --i) {
-            add_next_stops(result, stop, (date_time - boost::posix_time::hours(i * 24)).date() , date_time);
+    std::vector<ds::path_leg_t> unwind(query_context_t::dijkstra_state_t const& context, uint32_t stop) {
+        if (!context.settled.contains(stop)) {
+            throw std::runtime_error("Unable to find connection");
         }
-        for (size_t i = 0 ; i < 2 ; ++i) {
-            add_next_stops(result, stop, (date_time + boost::posix_time::hours(i * 24)).date() , date_time);
+        std::vector<ds::path_leg_t> legs;
+        for (auto next = stop ; next != ds::NO_INDEX ; next = context.parents[next]) {
+            legs.push_back(context.visited[next]);
         }
-        return result;
+        std::reverse(legs.begin(), legs.end());
+        return legs;
     }
 }
 
 namespace processing {
 
-    using next_stop_with_time_t = std::pair<ds::date_time_t, next_stop_t>;
-
-    map_graph_t::map_graph_t(
-            ds::value_by_id<ds::trip_ptr> &&trips,
-            ds::value_by_id<ds::stop_ptr> &&stops,
-            std::vector<ds::stop_time_ptr> &&stop_times,
-            ds::value_by_id<ds::service_ptr> &&services,
-            ds::value_by_id<ds::route_ptr>&& routes) noexcept :
-            trips(std::move(trips)), stops(std::move(stops)), stop_times(std::move(stop_times)),
-            services(std::move(services)), routes(std::move(routes)) {
+    // later trips of a pattern are later at every stop, so only the first running one of every pattern and
+    // service day is boarded
+    void get_next_stops(std::vector<std::pair<int32_t, uint32_t>>& result, ds::timetable_t const& timetable,
+            uint32_t stop, int32_t query_day, ds::seconds_t time, query_stats_t& stats) {
+        static_cast<void>(stats); // only counted into with PLANNER_QUERY_STATS
+        result.clear();
+        auto const today = ds::day_offset(time);
+        for (auto i = timetable.stop_patterns_begin[stop] ; i < timetable.stop_patterns_begin[stop + 1] ; ++i) {
+            auto const pattern = timetable.stop_patterns[i];
+            auto const position = timetable.stop_pattern_positions[i];
+            if (position + 1 == timetable.pattern_width(pattern)) {
+                continue;
+            }
+            auto const trips_begin = timetable.pattern_trips_begin[pattern];
+            auto const trip_count = timetable.pattern_trip_count(pattern);
+            auto const column = timetable.pattern_departures.cbegin() + timetable.pattern_time(pattern, position, 0);
+            for (auto day = today - query_context_t::dijkstra_state_t::PREVIOUS_DAYS ; day <= today + 1 ; ++day) {
+                auto const local = time - day * ds::DAY_SECONDS;
+                for (auto rank = static_cast<uint32_t>(std::lower_bound(column, column + trip_count, local) - column) ;
+                        rank < trip_count ; ++rank) {
+                    QUERY_STATS(++stats.stop_times);
+                    auto const trip = timetable.pattern_trips[trips_begin + rank];
+                    if (timetable.is_service_active(timetable.trip_services[trip], query_day + day)) {
+                        result.emplace_back(day, timetable.trip_stop_times_begin[trip] + position);
+                        break;
+                    }
+                    QUERY_STATS(++stats.services_rejected);
+                }
+            }
+        }
     }
 
-     std::vector<ds::path_leg_t> map_graph_t::journey(
-            std::string const& start, std::string const& finish, data_structures::date_time_t const& departure) const {
-        if (stops.count(start) == 0 || stops.count(finish) == 0) {
-            throw std::runtime_error("Unable to find start or finish stops by provided id");
-        }
-        auto const& source = stops.at(start);
-        auto const& target = stops.at(finish);
-        std::unordered_map<std::string, std::shared_ptr<list_t>> visited_stops;
-        std::unordered_set<std::string> used_trips;
-        std::priority_queue<
-                next_stop_with_time_t, std::vector<next_stop_with_time_t>, std::greater<> > queue;
-        queue.emplace(departure, next_stop_t(source, nullptr, nullptr, nullptr));
+}
+
+namespace {
+    // Settles stops in order of arrival until target is settled, with target NO_INDEX every reachable stop.
+    // Given a bound the queue is ordered by arrival plus the bound to target instead (A*), stops towards target
+    // are settled first and target still settles at its earliest arrival
+    void dijkstra(ds::timetable_t const& timetable, uint32_t source, uint32_t target,
+            ds::date_time_t const& departure, query_context_t::dijkstra_state_t& context,
+            query_stats_t& stats, processing::travel_time_bound_t const* bound = nullptr) {
+        QUERY_STATS(auto const started = query_stats_t::clock_t::now());
+        context.reset(timetable);
+        QUERY_STATS(stats.reset_time = query_stats_t::clock_t::now() - started);
+        auto& queue = context.queue;
+        auto& bounds = context.bounds;
+        auto push = [&](ds::seconds_t time, uint32_t destination, uint32_t from, uint32_t transfer, uint32_t transport) {
+            auto estimate = time;
+            if (bound != nullptr) {
+                if (!bounds.is_set(destination)) {
+                    bounds.set(destination) = (*bound)(timetable, destination, target);
+                }
+                estimate += bounds[destination];
+            }
+            queue.push_back(processing::dijkstra_entry_t{estimate, time, destination, from, transfer, transport});
+            std::push_heap(queue.begin(), queue.end(), std::greater<>());
+            QUERY_STATS(++stats.pushes, stats.peak_queue = std::max<uint64_t>(stats.peak_queue, queue.size()));
+        };
+        auto const query_day = departure.date();
+        push(ds::seconds_since(query_day, departure), source, ds::NO_INDEX, ds::NO_INDEX, ds::NO_INDEX);
         while (!queue.empty()) {
-            auto next = queue.top();
-            queue.pop();
-            if (visited_stops.count(next.second.destination->id) != 0) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<>());
+            auto const next = queue.back();
+            queue.pop_back();
+            QUERY_STATS(++stats.pops);
+            auto const stop = next.destination;
+            if (!context.settled.insert(stop)) {
+                QUERY_STATS(++stats.stale_pops);
                 continue;
             }
-            auto step = std::make_shared<list_t>();
-            step->stop = next.second.destination;
-            step->transfer = next.second.transfer;
-            step->stop_time = next.second.transport;
-            step->date_time = next.first;
-            if (next.second.source) {
-                step->parent = visited_stops.at(next.second.source->id);
-            }
-            visited_stops.emplace(next.second.destination->id, step);
-            if (next.second.destination->id == finish) {
+            QUERY_STATS(++stats.settled);
+            auto& step = context.visited[stop];
+            step.stop = stop;
+            step.transfer = next.transfer;
+            step.transport = next.transport;
+            step.arrival = ds::to_date_time(query_day, next.time);
+            context.parents[stop] = next.source;
+            if (stop == target) {
                 break;
             }
-            auto s_t = get_next_stops(next.second.destination, next.first);
+            processing::get_next_stops(context.next_stops, timetable, stop, query_day.day_number(), next.time, stats);
 
-            for (auto it = s_t.cbegin() ; it != s_t.cend() ; ++it) {
-                const auto& cur_trip = it->second->trip;
-                if (used_trips.count(cur_trip->id) != 0) {
+            for (auto const& next_stop : context.next_stops) {
+                auto const cur_trip = timetable.stop_time_trips[next_stop.second];
+                // first stop time of every trip instance (trip and service day) that is already queued.
+                // boarding it again further down the trip adds nothing new
+                auto& boarded = context.boarded_trip(cur_trip, next_stop.first);
+                if (boarded == ds::NO_INDEX) {
+                    boarded = timetable.trip_stop_times_begin[cur_trip + 1];
+                }
+                if (boarded <= next_stop.second + 1) {
                     continue;
                 }
-                used_trips.insert(cur_trip->id);
-                auto next_stop_time_it = std::upper_bound(
-                        cur_trip->stop_times.cbegin(), cur_trip->stop_times.cend(), it->second->sequence,
-                        [](int const& l, ds::stop_time_ptr const& r) {
-                            return l < r->sequence;
-                        });
-                for ( ; next_stop_time_it != cur_trip->stop_times.cend() ; ++next_stop_time_it) {
-                    queue.emplace(
-                            date_with_other_time(it->first, (*next_stop_time_it)->arrival),
-                            next_stop_t(
-                                    (*next_stop_time_it)->stop,
-                                    next.second.destination,
-                                    nullptr,
-                                    (*next_stop_time_it)));
+                QUERY_STATS(++stats.trips_scanned);
+                for (auto stop_time = next_stop.second + 1 ; stop_time < boarded ; ++stop_time) {
+                    push(next_stop.first * ds::DAY_SECONDS + timetable.stop_time_arrivals[stop_time],
+                            timetable.stop_time_stops[stop_time], stop, ds::NO_INDEX, stop_time);
                 }
+                boarded = next_stop.second + 1;
             }
-            for (auto const& transfer : next.second.destination->transfers) {
-                queue.emplace(next.first + transfer->duration,
-                        next_stop_t(transfer->to, next.second.destination, transfer, nullptr));
+            for (auto transfer = timetable.stop_transfers_begin[stop] ;
+                    transfer < timetable.stop_transfers_begin[stop + 1] ; ++transfer) {
+                push(next.time + timetable.transfer_durations[transfer],
+                        timetable.transfer_targets[transfer], stop, transfer, ds::NO_INDEX);
             }
         }
-        if (visited_stops.count(finish) == 0) {
-            throw std::runtime_error("Unable to find connection");
+        QUERY_STATS(stats.search_time = query_stats_t::clock_t::now() - started - stats.reset_time);
+    }
+}
+
+namespace processing {
+
+    engine_t engine_from_string(std::string const& name) {
+        if (name == "dijkstra") {
+            return engine_t::dijkstra;
+        }
+        if (name == "raptor") {
+            return engine_t::raptor;
+        }
+        if (name == "csa") {
+            return engine_t::csa;
+        }
+        if (name == "trip_based") {
+            return engine_t::trip_based;
+        }
+        if (name == "astar") {
+            return engine_t::astar;
+        }
+        throw std::runtime_error("Unknown routing engine: " + name);
+    }
+
+    size_t count_trips(ds::timetable_t const& timetable, std::vector<ds::path_leg_t> const& legs) {
+        size_t trips = 0;
+        auto last_trip = ds::NO_INDEX;
+        for (auto const& leg : legs) {
+            auto const trip = leg.transport == ds::NO_INDEX ? ds::NO_INDEX : timetable.stop_time_trips[leg.transport];
+            if (trip != ds::NO_INDEX && trip != last_trip) {
+                ++trips;
+            }
+            last_trip = trip;
+        }
+        return trips;
+    }
+
+    map_graph_t::map_graph_t(ds::timetable_t&& timetable) :
+            timetable(std::move(timetable)), raptor(this->timetable), csa(this->timetable),
+            trip_based(this->timetable), bound(this->timetable) {
+    }
+
+    void map_graph_t::check_engine(engine_t engine) const {
+        if (engine == engine_t::trip_based && !timetable.has_trip_transfers()) {
+            throw std::runtime_error("Timetable has no trip transfers, compile it with --trip_transfers");
         }
-        return unwind(visited_stops.at(finish));
     }
-}
\ No newline at end of file
+
+    ds::timetable_t const& map_graph_t::get_timetable() const {
+        return timetable;
+    }
+
+    std::vector<ds::path_leg_t> map_graph_t::journey(std::string const& start, std::string const& finish,
+            data_structures::date_time_t const& departure, engine_t engine) const {
+        return journey(start, finish, departure, thread_context(), engine);
+    }
+
+    std::vector<ds::path_leg_t> map_graph_t::journey(std::string const& start, std::string const& finish,
+            data_structures::date_time_t const& departure, query_context_t& context, engine_t engine) const {
+        QUERY_STATS(stats_scope_t stats_scope(context.stats));
+        auto const source = timetable.find_stop(start);
+        auto const target = timetable.find_stop(finish);
+        if (source == ds::NO_INDEX || target == ds::NO_INDEX) {
+            throw std::runtime_error("Unable to find start or finish stops by provided id");
+        }
+        check_engine(engine);
+        if (engine == engine_t::raptor) {
+            return raptor.journey(timetable, source, target, departure, context.raptor);
+        }
+        if (engine == engine_t::csa) {
+            return csa.journey(timetable, source, target, departure, context.csa);
+        }
+        if (engine == engine_t::trip_based) {
+            return trip_based.journey(timetable, source, target, departure, context.trip_based);
+        }
+        dijkstra(timetable, source, target, departure, context.dijkstra, context.stats,
+                engine == engine_t::astar ? &bound : nullptr);
+        QUERY_STATS(auto const unwinding = query_stats_t::clock_t::now());
+        auto legs = unwind(context.dijkstra, target);
+        QUERY_STATS(context.stats.unwind_time = query_stats_t::clock_t::now() - unwinding);
+        return legs;
+    }
+
+    std::vector<std::vector<ds::path_leg_t>> map_graph_t::profile(std::string const& start,
+            std::string const& finish, ds::date_time_t const& window_begin, ds::date_time_t const& window_end) const {
+        return profile(start, finish, window_begin, window_end, thread_context());
+    }
+
+    std::vector<std::vector<ds::path_leg_t>> map_graph_t::profile(std::string const& start,
+            std::string const& finish, ds::date_time_t const& window_begin, ds::date_time_t const& window_end,
+            query_context_t& context) const {
+        QUERY_STATS(stats_scope_t stats_scope(context.stats));
+        auto const source = timetable.find_stop(start);
+        auto const target = timetable.find_stop(finish);
+        if (source == ds::NO_INDEX || target == ds::NO_INDEX) {
+            throw std::runtime_error("Unable to find start or finish stops by provided id");
+        }
+        if (window_end < window_begin) {
+            throw std::runtime_error("Departure window ends before it begins");
+        }
+        return raptor.profile(timetable, source, target, window_begin, window_end, context.raptor);
+    }
+
+    std::vector<std::vector<ds::path_leg_t>> map_graph_t::pareto_journeys(std::string const& start,
+            std::string const& finish, ds::date_time_t const& departure, uint32_t max_transfers) const {
+        return pareto_journeys(start, finish, departure, thread_context(), max_transfers);
+    }
+
+    std::vector<std::vector<ds::path_leg_t>> map_graph_t::pareto_journeys(std::string const& start,
+            std::string const& finish, ds::date_time_t const& departure, query_context_t& context,
+            uint32_t max_transfers) const {
+        QUERY_STATS(stats_scope_t stats_scope(context.stats));
+        auto const source = timetable.find_stop(start);
+        auto const target = timetable.find_stop(finish);
+        if (source == ds::NO_INDEX || target == ds::NO_INDEX) {
+            throw std::runtime_error("Unable to find start or finish stops by provided id");
+        }
+        return raptor.pareto(timetable, source, target, departure, max_transfers, context.raptor);
+    }
+
+    std::vector<ds::date_time_t> map_graph_t::earliest_arrivals(std::string const& start,
+            ds::date_time_t const& departure, engine_t engine) const {
+        return earliest_arrivals(start, departure, thread_context(), engine);
+    }
+
+    std::vector<ds::date_time_t> map_graph_t::earliest_arrivals(std::string const& start,
+            ds::date_time_t const& departure, query_context_t& context, engine_t engine) const {
+        QUERY_STATS(stats_scope_t stats_scope(context.stats));
+        auto const source = timetable.find_stop(start);
+        if (source == ds::NO_INDEX) {
+            throw std::runtime_error("Unable to find start stop by provided id");
+        }
+        check_engine(engine);
+        if (engine == engine_t::raptor) {
+            return raptor.earliest_arrivals(timetable, source, departure, context.raptor);
+        }
+        if (engine == engine_t::csa) {
+            return csa.earliest_arrivals(timetable, source, departure, context.csa);
+        }
+        if (engine == engine_t::trip_based) {
+            return trip_based.earliest_arrivals(timetable, source, departure, context.trip_based);
+        }
+        // without a target there is nothing to guide A*, both search like Dijkstra
+        dijkstra(timetable, source, ds::NO_INDEX, departure, context.dijkstra, context.stats);
+        std::vector<ds::date_time_t> arrivals(timetable.stop_count(), boost::posix_time::not_a_date_time);
+        for (uint32_t stop = 0 ; stop < arrivals.size() ; ++stop) {
+            if (context.dijkstra.settled.contains(stop)) {
+                arrivals[stop] = context.dijkstra.visited[stop].arrival;
+            }
+        }
+        return arrivals;
+    }
+}
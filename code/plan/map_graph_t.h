@@ -1,28 +1,108 @@
 #ifndef PLANNER_MAP_GRAPH_T_H
 #define PLANNER_MAP_GRAPH_T_H
 
-#include "structures.h"
+#include "timetable_t.h"
+#include "csa_t.h"
+#include "query_context_t.h"
+#include "raptor_t.h"
+#include "travel_time_bound_t.h"
+#include "trip_based_t.h"
+
+#include <string>
+#include <utility>
+#include <vector>
 
 namespace processing {
 
+    enum class engine_t {
+        dijkstra,
+        raptor,
+        csa,
+        trip_based, // needs a timetable compiled with trip transfers
+        astar // dijkstra guided by the great-circle distance to the target
+    };
+
+    engine_t engine_from_string(std::string const& name);
+
+    // vehicles boarded on the way, consecutive legs on the same trip are one ride
+    size_t count_trips(data_structures::timetable_t const& timetable,
+            std::vector<data_structures::path_leg_t> const& legs);
+
+    // Stop times Dijkstra boards at stop at time: the first running trip of every pattern and service day. Times
+    // are seconds since midnight of the query day, service days are offsets from it
+    void get_next_stops(std::vector<std::pair<int32_t, uint32_t>>& result,
+            data_structures::timetable_t const& timetable, uint32_t stop, int32_t query_day,
+            data_structures::seconds_t time, query_stats_t& stats);
+
     class map_graph_t {
-        data_structures::value_by_id<data_structures::trip_ptr> trips;
-        data_structures::value_by_id<data_structures::stop_ptr > stops;
-        std::vector<data_structures::stop_time_ptr> stop_times;
-        data_structures::value_by_id<data_structures::service_ptr> services;
-        data_structures::value_by_id<data_structures::route_ptr> routes;
+        data_structures::timetable_t timetable;
+        raptor_t raptor;
+        csa_t csa;
+        trip_based_t trip_based;
+        travel_time_bound_t bound;
+
+        void check_engine(engine_t engine) const;
     public:
-        map_graph_t(
-                data_structures::value_by_id<data_structures::trip_ptr>&& trips,
-                data_structures::value_by_id<data_structures::stop_ptr >&& stops,
-                std::vector<data_structures::stop_time_ptr>&& stop_times,
-                data_structures::value_by_id<data_structures::service_ptr>&& services,
-                data_structures::value_by_id<data_structures::route_ptr>&& routes) noexcept;
+        explicit map_graph_t(data_structures::timetable_t&& timetable);
+
+        data_structures::timetable_t const& get_timetable() const;
 
         std::vector<data_structures::path_leg_t> journey(
                 std::string const& start,
                 std::string const& finish,
-                data_structures::date_time_t const& departure) const;
+                data_structures::date_time_t const& departure,
+                engine_t engine = engine_t::dijkstra) const;
+
+        // same with scratch memory owned by the caller, which also keeps the stats of the query
+        std::vector<data_structures::path_leg_t> journey(
+                std::string const& start,
+                std::string const& finish,
+                data_structures::date_time_t const& departure,
+                query_context_t& context,
+                engine_t engine = engine_t::dijkstra) const;
+
+        // Pareto front of arrival time and number of transfers: journeys by transfers, each one arriving earlier
+        // than all journeys with fewer transfers. Found by a single RAPTOR search whatever the engine
+        std::vector<std::vector<data_structures::path_leg_t>> pareto_journeys(
+                std::string const& start,
+                std::string const& finish,
+                data_structures::date_time_t const& departure,
+                uint32_t max_transfers = NO_LIMIT) const;
+
+        std::vector<std::vector<data_structures::path_leg_t>> pareto_journeys(
+                std::string const& start,
+                std::string const& finish,
+                data_structures::date_time_t const& departure,
+                query_context_t& context,
+                uint32_t max_transfers = NO_LIMIT) const;
+
+        // Pareto optimal journeys between two stops over a window of departures, found in one profile search
+        // instead of a query per departure. Ordered by departure, the first leg of a journey gives it
+        std::vector<std::vector<data_structures::path_leg_t>> profile(
+                std::string const& start,
+                std::string const& finish,
+                data_structures::date_time_t const& window_begin,
+                data_structures::date_time_t const& window_end) const;
+
+        std::vector<std::vector<data_structures::path_leg_t>> profile(
+                std::string const& start,
+                std::string const& finish,
+                data_structures::date_time_t const& window_begin,
+                data_structures::date_time_t const& window_end,
+                query_context_t& context) const;
+
+        // earliest arrival at every stop by stop index from a single search without a target,
+        // not_a_date_time for stops that can not be reached
+        std::vector<data_structures::date_time_t> earliest_arrivals(
+                std::string const& start,
+                data_structures::date_time_t const& departure,
+                engine_t engine = engine_t::dijkstra) const;
+
+        std::vector<data_structures::date_time_t> earliest_arrivals(
+                std::string const& start,
+                data_structures::date_time_t const& departure,
+                query_context_t& context,
+                engine_t engine = engine_t::dijkstra) const;
     };
 
 }
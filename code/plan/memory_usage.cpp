@@ -0,0 +1,51 @@
+#include "memory_usage.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <unistd.h>
+
+#ifdef PLANNER_ALLOCATION_COUNTS
+namespace {
+    // a plain thread local, counting costs no synchronisation between threads
+    thread_local uint64_t allocations = 0;
+}
+
+void* operator new(size_t size) {
+    ++allocations;
+    if (auto const memory = std::malloc(size == 0 ? 1 : size)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+#endif
+
+namespace util {
+    uint64_t thread_allocations() {
+#ifdef PLANNER_ALLOCATION_COUNTS
+        return allocations;
+#else
+        return 0;
+#endif
+    }
+
+    size_t resident_bytes() {
+        auto const file = std::fopen("/proc/self/statm", "r");
+        if (file == nullptr) {
+            return 0;
+        }
+        unsigned long size = 0, resident = 0;
+        auto const read = std::fscanf(file, "%lu %lu", &size, &resident);
+        std::fclose(file);
+        return read == 2 ? resident * static_cast<size_t>(::sysconf(_SC_PAGESIZE)) : 0;
+    }
+}
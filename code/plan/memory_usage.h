@@ -0,0 +1,24 @@
+#ifndef PLANNER_MEMORY_USAGE_H
+#define PLANNER_MEMORY_USAGE_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace util {
+
+#ifdef PLANNER_ALLOCATION_COUNTS
+constexpr bool ALLOCATION_COUNTS = true;
+#else
+constexpr bool ALLOCATION_COUNTS = false;
+#endif
+
+// allocations by operator new on the calling thread since it started. Counted by replacing the global operator
+// new, only built with PLANNER_ALLOCATION_COUNTS, always 0 without it
+uint64_t thread_allocations();
+
+// resident set size of the process, 0 where /proc is not available
+size_t resident_bytes();
+
+} // util
+
+#endif //PLANNER_MEMORY_USAGE_H
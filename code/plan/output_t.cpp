@@ -0,0 +1,44 @@
+#include "output_t.h"
+
+#include <cstdio>
+#include <exception>
+#include <iostream>
+
+namespace util {
+    output_t::output_t(std::string const& path) : path(path) {
+        if (path != "-") {
+            file.open(path, std::ios::trunc);
+            if (!file) {
+                throw std::runtime_error("Unable to open output " + path);
+            }
+        }
+    }
+
+    std::ostream& output_t::stream() {
+        return path == "-" ? std::cout : file;
+    }
+
+    void output_t::close() {
+        stream().flush();
+        if (!stream()) {
+            throw std::runtime_error("Unable to write output " + path);
+        }
+    }
+
+    void append_json(std::string& out, std::string const& field) {
+        out += '"';
+        for (auto c : field) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+        out += '"';
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef PLANNER_OUTPUT_T_H
+#define PLANNER_OUTPUT_T_H
+
+#include <fstream>
+#include <ostream>
+#include <string>
+
+namespace util {
+
+    // Where a mode writes its results: the file at path, truncated, or standard output for '-'. Throws when the
+    // file can not be opened, close throws when anything written was lost
+    class output_t {
+        std::ofstream file;
+        std::string path;
+    public:
+        explicit output_t(std::string const& path);
+
+        std::ostream& stream();
+
+        void close();
+    };
+
+    // field as a JSON string, quotes, backslashes and control characters escaped
+    void append_json(std::string& out, std::string const& field);
+
+}
+
+#endif //PLANNER_OUTPUT_T_H
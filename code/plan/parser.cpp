@@ -1,22 +1,37 @@
 #include "parser.h"
 #include "csv.h"
+#include "memory_usage.h"
+#include "task_graph_t.h"
 
 #include <boost/filesystem.hpp>
 #include <boost/range/iterator_range.hpp>
+#include <boost/utility/string_view.hpp>
 
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cstring>
+#include <ctime>
 #include <exception>
+#include <map>
+#include <memory>
 #include <unordered_map>
 #include <iostream>
 #include <utility>
 
 namespace fs = boost::filesystem;
 namespace ds = data_structures;
+using util::task_graph_t;
 
 namespace {
     template<int column_count>
     using csv_reader = io::CSVReader<column_count, io::trim_chars<' '>, io::double_quote_escape<',','\"'>>;
 
+    // tables are read from a private mapping in place, without a copy into a buffer or a reader thread
+    std::shared_ptr<io::MappedFile> map_table(std::string const& path) {
+        return std::make_shared<io::MappedFile>(path);
+    }
+
     constexpr int AGENCIES_COLUMN_COUNT = 4;
     constexpr int ROUTES_COLUMN_COUNT = 6;
     constexpr int REGULAR_SERVICES_COLUMN_COUNT = 10;
@@ -26,16 +41,50 @@ namespace {
     constexpr int TRIPS_COLUMN_COUNT = 6;
     constexpr int STOP_TIMES_COLUMN_COUNT = 5;
 
-    ds::value_by_id<ds::agency_ptr> parse_agencies(fs::path const& path) {
-        ds::value_by_id<ds::agency_ptr> agencies;
-        csv_reader<AGENCIES_COLUMN_COUNT> reader(path.string());
-        reader.read_header(io::ignore_extra_column, "agency_id", "agency_name", "agency_url", "agency_timezone");
-        auto agency = std::make_shared<ds::agency_t>();
-        while (reader.read_row(agency->id, agency->name, agency->url, agency->timezone)) {
-            agencies.emplace(agency->id,  std::move(agency));
-            agency = std::make_shared<ds::agency_t>();
+    boost::string_view view(io::column_view const& column) {
+        return boost::string_view(column.data(), column.size());
+    }
+
+    // the referenced entity, ids are resolved through the perfect hash of the frozen table
+    template<typename T>
+    T const& find_by_id(ds::value_by_id<T> const& values, io::column_view const& id, char const* kind) {
+        auto const handle = values.find(view(id));
+        if (handle == ds::NO_INDEX) {
+            throw std::runtime_error(std::string("Unknown ") + kind + " id: " + view(id).to_string());
         }
-        return agencies;
+        return values[handle];
+    }
+
+    // interns the id, a repeated id keeps the first entity like before
+    template<typename T>
+    void add_by_id(ds::value_by_id<T>& values, io::column_view const& id, T value) {
+        auto const handle = values.emplace(view(id), value);
+        value->id = values.id(handle.first);
+    }
+
+    boost::string_view copy(ds::arena_t& arena, io::column_view const& column) {
+        return arena.copy(view(column));
+    }
+
+    // Puts the children of every owner next to each other into one array from the arena. for_each_child calls
+    // its argument for every child, the children of one owner keep that order. range_of gives the range of the
+    // owner of a child, ranges have to be empty before
+    template<typename T, typename for_each_t, typename range_of_t>
+    void group_children(ds::arena_t& arena, size_t count, for_each_t const& for_each_child,
+            range_of_t const& range_of) {
+        for_each_child([&](T child) {
+            ++range_of(child).count;
+        });
+        auto next = arena.create_array<T>(count);
+        for_each_child([&](T child) {
+            auto& range = range_of(child);
+            if (range.first == nullptr) {
+                range.first = next;
+                next += range.count;
+                range.count = 0;
+            }
+            range.first[range.count++] = child;
+        });
     }
 
     bool try_get_table_path(fs::path const& directory, fs::path const& file, fs::path& result) {
@@ -54,215 +103,504 @@ namespace {
         return result;
     }
 
-    ds::value_by_id<ds::route_ptr> parse_routes(fs::path const& path, ds::value_by_id<ds::agency_ptr> const& agencies) {
-        ds::value_by_id<ds::route_ptr> routes;
-        csv_reader<ROUTES_COLUMN_COUNT> reader(path.string());
+}
+
+namespace util {
+    void parse_agencies(std::string const& path, ds::feed_t& feed) {
+        auto& arena = feed.agency_arena;
+        csv_reader<AGENCIES_COLUMN_COUNT> reader(path, map_table(path));
+        reader.read_header(io::ignore_extra_column, "agency_id", "agency_name", "agency_url", "agency_timezone");
+        io::column_view id, name, url, timezone;
+        while (reader.read_row(id, name, url, timezone)) {
+            auto const agency = arena.create<ds::agency_t>();
+            agency->name = copy(arena, name);
+            agency->url = copy(arena, url);
+            agency->timezone = copy(arena, timezone);
+            add_by_id(feed.agencies, id, agency);
+        }
+        feed.agencies.freeze();
+    }
+
+    void parse_routes(std::string const& path, ds::feed_t& feed) {
+        auto& arena = feed.route_arena;
+        csv_reader<ROUTES_COLUMN_COUNT> reader(path, map_table(path));
         reader.read_header(io::ignore_extra_column,
                 "route_id", "agency_id", "route_short_name", "route_long_name", "route_desc" ,"route_type");
-        auto route = std::make_shared<ds::route_t>();
-        std::string agency_id;
-        while (reader.read_row(route->id, agency_id, route->short_name, route->long_name, route->desc, route->type)) {
-            route->agency = agencies.at(agency_id);
-            agencies.at(agency_id)->routes.push_back(route);
-            routes.emplace(route->id, std::move(route));
-            route = std::make_shared<ds::route_t>();
+        io::column_view id, agency_id, short_name, long_name, desc;
+        int type;
+        while (reader.read_row(id, agency_id, short_name, long_name, desc, type)) {
+            auto const route = arena.create<ds::route_t>();
+            route->agency = find_by_id(feed.agencies, agency_id, "agency");
+            route->short_name = copy(arena, short_name);
+            route->long_name = copy(arena, long_name);
+            route->desc = copy(arena, desc);
+            route->type = type;
+            add_by_id(feed.routes, id, route);
         }
-        return routes;
+        feed.routes.freeze();
     }
 
-    ds::value_by_id<ds::service_ptr> parse_regular_services(fs::path const& path) {
-        ds::value_by_id<ds::service_ptr> services;
-        csv_reader<REGULAR_SERVICES_COLUMN_COUNT> reader(path.string());
+    void parse_regular_services(std::string const& path, ds::feed_t& feed) {
+        csv_reader<REGULAR_SERVICES_COLUMN_COUNT> reader(path, map_table(path));
         reader.read_header(io::ignore_extra_column, "service_id", "monday", "tuesday", "wednesday", "thursday",
                 "friday", "saturday", "sunday" , "start_date", "end_date");
-        auto service = std::make_shared<ds::service_t>();
         int week_days[7];
+        io::column_view id;
         std::string start_date, end_date;
-        while (reader.read_row(service->id, week_days[0], week_days[1], week_days[2], week_days[3], week_days[4],
+        while (reader.read_row(id, week_days[0], week_days[1], week_days[2], week_days[3], week_days[4],
                 week_days[5], week_days[6], start_date, end_date)) {
+            auto const service = feed.service_arena.create<ds::service_t>();
             service->start = boost::gregorian::from_undelimited_string(start_date);
             service->end = boost::gregorian::from_undelimited_string(end_date);
+            // columns start with monday, boost week days with sunday
             for (size_t i = 0 ; i < sizeof(week_days) / sizeof(week_days[0]) ; ++i) {
                 if (week_days[i] == 1) {
-                    service->week_days.insert(ds::week_day(i));
+                    service->week_days |= 1u << ((i + 1) % 7);
                 }
             }
-            services.emplace(service->id, std::move(service));
-            service = std::make_shared<ds::service_t>();
+            add_by_id(feed.services, id, service);
         }
-        return services;
+        feed.services.freeze();
     }
 
-    void parse_exceptional_services(fs::path const& path, ds::value_by_id<ds::service_ptr> const& services) {
-        csv_reader<EXCEPTIONAL_SERVICES_COLUMN_COUNT> reader(path.string());
+    void parse_exceptional_services(std::string const& path, ds::feed_t& feed) {
+        csv_reader<EXCEPTIONAL_SERVICES_COLUMN_COUNT> reader(path, map_table(path));
         reader.read_header(io::ignore_extra_column, "service_id", "date", "exception_type");
-        auto service_exception = std::make_shared<ds::service_exception_t>();
+        std::vector<ds::service_exception_ptr> exceptions;
         std::string date;
-        std::string service_id;
-        while (reader.read_row(service_id, date, service_exception->type)) {
-            if (services.count(service_id) == 0) {
+        io::column_view service_id;
+        int type;
+        while (reader.read_row(service_id, date, type)) {
+            auto const service = feed.services.find(view(service_id));
+            if (service == ds::NO_INDEX) {
                 assert(false);
                 continue;
             }
+            auto const service_exception = feed.service_exception_arena.create<ds::service_exception_t>();
+            service_exception->service = feed.services[service];
             service_exception->date = boost::gregorian::from_undelimited_string(date);
-            services.at(service_id)->exceptions.emplace(service_exception->date, std::move(service_exception));
-            service_exception = std::make_shared<ds::service_exception_t>();
+            service_exception->type = type;
+            exceptions.push_back(service_exception);
         }
+        group_children<ds::service_exception_ptr>(feed.service_exception_arena, exceptions.size(),
+                [&](auto const& visit) {
+            for (auto exception : exceptions) {
+                visit(exception);
+            }
+        }, [](ds::service_exception_ptr exception) -> ds::range_t<ds::service_exception_ptr>& {
+            return exception->service->exceptions;
+        });
+        // the first exception of a date wins
+        for (auto const& service : feed.services) {
+            auto& range = service.second->exceptions;
+            std::stable_sort(range.begin(), range.end(), [](ds::service_exception_ptr l, ds::service_exception_ptr r) {
+                return l->date < r->date;
+            });
+            range.count = static_cast<uint32_t>(std::unique(range.begin(), range.end(),
+                    [](ds::service_exception_ptr l, ds::service_exception_ptr r) {
+                return l->date == r->date;
+            }) - range.begin());
+        }
+        feed.service_exception_count = exceptions.size();
     }
 
-    ds::value_by_id<ds::stop_ptr> parse_stops(fs::path const& path) {
-        csv_reader<STOPS_COLUMN_COUNT> reader(path.string());
+    void parse_stops(std::string const& path, ds::feed_t& feed) {
+        auto& arena = feed.stop_arena;
+        csv_reader<STOPS_COLUMN_COUNT> reader(path, map_table(path));
         reader.read_header(io::ignore_extra_column | io::ignore_missing_column, "stop_id", "stop_name", "stop_lat",
-                "stop_lan", "parent_station");
-        auto stop = std::make_shared<ds::stop_t>();
-        ds::value_by_id<ds::stop_ptr> stops;
-        double lat, lan;
-        std::string parent_id;
-        std::vector<std::pair<ds::stop_ptr, std::string>> with_parent;
-        while (reader.read_row(stop->id, stop->name, lat, lan, parent_id)) {
-            stop->location = ds::point_t(lat, lan);
+                "stop_lon", "parent_station");
+        double lat = 0, lon = 0;
+        io::column_view id, name, parent_id;
+        std::vector<std::pair<ds::stop_ptr, boost::string_view>> with_parent;
+        while (reader.read_row(id, name, lat, lon, parent_id)) {
+            auto const stop = arena.create<ds::stop_t>();
+            stop->name = copy(arena, name);
+            stop->location = ds::point_t(lat, lon);
             if (!parent_id.empty()) {
-                with_parent.emplace_back(stop, parent_id);
+                with_parent.emplace_back(stop, copy(arena, parent_id));
             }
-            stops.emplace(stop->id, std::move(stop));
-            stop = std::make_shared<ds::stop_t>();
+            add_by_id(feed.stops, id, stop);
         }
+        feed.stops.freeze();
         for (auto& update : with_parent) {
-            update.first->parent = stops.at(update.second);
+            update.first->parent = find_by_id(feed.stops, io::column_view(update.second.data(), update.second.size()),
+                    "parent station");
         }
-        return stops;
     }
 
-    void parse_transfers(fs::path const& path, ds::value_by_id<ds::stop_ptr> const& stops) {
-       csv_reader<TRANSFERS_COLUMN_COUNT> reader(path.string());
+    void parse_transfers(std::string const& path, ds::feed_t& feed) {
+       csv_reader<TRANSFERS_COLUMN_COUNT> reader(path, map_table(path));
        reader.read_header(io::ignore_extra_column, "from_stop_id", "to_stop_id", "transfer_type", "min_transfer_time");
-       auto transfer = std::make_shared<ds::transfer_t>();
-       std::string from, to;
-       int time;
-       while (reader.read_row(from, to, transfer->type, time)) {
-           transfer->from = stops.at(from);
-           transfer->to = stops.at(to);
-           transfer->duration = boost::posix_time::seconds(time);
-           stops.at(from)->transfers.emplace_back(std::move(transfer));
-           transfer = std::make_shared<ds::transfer_t>();
+       std::vector<ds::transfer_ptr> transfers;
+       io::column_view from, to;
+       int type, time;
+       while (reader.read_row(from, to, type, time)) {
+           auto const transfer = feed.transfer_arena.create<ds::transfer_t>();
+           transfer->from = find_by_id(feed.stops, from, "stop");
+           transfer->to = find_by_id(feed.stops, to, "stop");
+           transfer->type = type;
+           transfer->duration = time;
+           transfers.push_back(transfer);
        }
+       group_children<ds::transfer_ptr>(feed.transfer_arena, transfers.size(), [&](auto const& visit) {
+           for (auto transfer : transfers) {
+               visit(transfer);
+           }
+       }, [](ds::transfer_ptr transfer) -> ds::range_t<ds::transfer_ptr>& {
+           return transfer->from->transfers;
+       });
+       feed.transfer_count = transfers.size();
     }
 
-    ds::value_by_id<ds::trip_ptr> parse_trips(fs::path const& path,
-            ds::value_by_id<ds::route_ptr> const& routes, ds::value_by_id<ds::service_ptr> const& services) {
-        csv_reader<TRIPS_COLUMN_COUNT> reader(path.string());
+    void parse_trips(std::string const& path, ds::feed_t& feed) {
+        auto& arena = feed.trip_arena;
+        csv_reader<TRIPS_COLUMN_COUNT> reader(path, map_table(path));
         reader.read_header(io::ignore_extra_column, "route_id", "service_id", "trip_id", "trip_headsign",
                 "trip_short_name", "direction_id");
-        auto trip = std::make_shared<ds::trip_t>();
-        ds::value_by_id<ds::trip_ptr> trips;
-        std::string route_id, service_id;
-        while (reader.read_row(route_id, service_id, trip->id, trip->head_sign, trip->short_name, trip->direction)) {
-            trip->route = routes.at(route_id);
-            trip->route->trips.push_back(trip);
-            trip->service = services.at(service_id);
-            trip->service->trips.push_back(trip);
-            trips.emplace(trip->id, std::move(trip));
-            trip = std::make_shared<ds::trip_t>();
+        io::column_view route_id, service_id, id, head_sign, short_name;
+        int direction;
+        while (reader.read_row(route_id, service_id, id, head_sign, short_name, direction)) {
+            auto const trip = arena.create<ds::trip_t>();
+            trip->route = find_by_id(feed.routes, route_id, "route");
+            trip->service = find_by_id(feed.services, service_id, "service");
+            trip->head_sign = copy(arena, head_sign);
+            trip->short_name = copy(arena, short_name);
+            trip->direction = direction;
+            add_by_id(feed.trips, id, trip);
+        }
+        feed.trips.freeze();
+    }
+
+}
+
+namespace {
+    // H:MM:SS with up to three hour digits, hours past 24 are trips running over midnight
+    ds::seconds_t parse_service_time(boost::string_view text) {
+        size_t i = 0;
+        ds::seconds_t hours = 0;
+        while (i < text.size() && i < 4 && text[i] >= '0' && text[i] <= '9') {
+            hours = hours * 10 + (text[i++] - '0');
+        }
+        auto const hour_digits = i;
+        auto two_digits = [&](ds::seconds_t& value) {
+            if (text.size() < i + 3 || text[i] != ':' || text[i + 1] < '0' || text[i + 1] > '5'
+                    || text[i + 2] < '0' || text[i + 2] > '9') {
+                return false;
+            }
+            value = (text[i + 1] - '0') * 10 + (text[i + 2] - '0');
+            i += 3;
+            return true;
+        };
+        ds::seconds_t minutes, seconds;
+        if (hour_digits == 0 || hour_digits > 3 || !two_digits(minutes) || !two_digits(seconds) || i != text.size()) {
+            throw std::runtime_error("Invalid time: " + text.to_string());
         }
-        return trips;
+        return hours * 60 * 60 + minutes * 60 + seconds;
     }
 
-    std::vector<ds::stop_time_ptr> parse_stop_times(fs::path const& path, ds::value_by_id<ds::trip_ptr> const& trips,
-            ds::value_by_id<ds::stop_ptr> const& stops) {
-        csv_reader<STOP_TIMES_COLUMN_COUNT> reader(path.string());
+    // stop times of a part of stop_times.txt in file order, allocated from the arena of the part
+    struct stop_time_rows_t {
+        ds::arena_t* arena = nullptr;
+        std::vector<ds::stop_time_ptr> stop_times;
+    };
+
+    // columns are read as views into the reader buffer, so a row costs no allocation besides bumping the
+    // arena and the growth of rows
+    template<typename reader_t>
+    void read_stop_times(reader_t& reader, ds::value_by_id<ds::trip_ptr> const& trips,
+            ds::value_by_id<ds::stop_ptr> const& stops, stop_time_rows_t& rows) {
         reader.read_header(io::ignore_extra_column, "trip_id", "arrival_time", "departure_time", "stop_id",
                 "stop_sequence");
-        auto stop_time = std::make_shared<ds::stop_time_t>();
-        std::vector<ds::stop_time_ptr> stop_times;
-        std::string trip_id, stop_id, arrival, departure;
-        while (reader.read_row(trip_id, arrival, departure, stop_id, stop_time->sequence)) {
-            stop_time->arrival = boost::posix_time::duration_from_string(arrival);
-            stop_time->departure = boost::posix_time::duration_from_string(departure);
-            stop_time->trip = trips.at(trip_id);
-            stop_time->trip->stop_times.push_back(stop_time);
-            stop_time->stop = stops.at(stop_id);
-            stop_time->stop->stop_times.push_back(stop_time);
-            stop_times.emplace_back(std::move(stop_time));
-            stop_time = std::make_shared<ds::stop_time_t>();
+        io::column_view trip_id, arrival, departure, stop_id;
+        int sequence;
+        while (reader.read_row(trip_id, arrival, departure, stop_id, sequence)) {
+            auto const stop_time = rows.arena->create<ds::stop_time_t>();
+            stop_time->sequence = sequence;
+            stop_time->arrival = parse_service_time(view(arrival));
+            stop_time->departure = parse_service_time(view(departure));
+            stop_time->trip = find_by_id(trips, trip_id, "trip");
+            stop_time->stop = find_by_id(stops, stop_id, "stop");
+            rows.stop_times.push_back(stop_time);
         }
-        return stop_times;
     }
 
-    void print_trip(ds::trip_ptr const& trip) {
-       std::cout << "Trip short name: " << trip->short_name << std::endl;
-       std::cout << "Trip stop times: " << std::endl;
-       for (auto const& stop_time : trip->stop_times) {
-           std::cout << "\tSequence num: " << stop_time->sequence << std::endl;
-           std::cout << "\tStop name: " << stop_time->stop->name << std::endl;
-           std::cout << "\tStop id: " << stop_time->stop->id << std::endl;
-           std::cout << "\tArrival time: " << stop_time->arrival << std::endl;
-           std::cout << "\tDeparture time: " << stop_time->departure << std::endl;
-       }
+    // stop_times.txt mapped into memory and cut into parts on line boundaries, every part is read from the
+    // mapping in place after a copy of the header. Quoted fields spanning lines are not supported here, none
+    // of the stop_times columns used can contain one. A part reads and writes no byte outside its range, so parts
+    // sharing a page or a 16 byte block at their edges do not race
+    struct stop_times_file_t {
+        fs::path path;
+        size_t part_count = 1;
+        std::shared_ptr<io::MappedFile> file;
+        std::vector<size_t> boundaries; // begin of every part and the end of the last one
+
+        // the parts terminate their lines in place, so the boundaries are found before any part is read
+        void load() {
+            file = std::make_shared<io::MappedFile>(path.string());
+            auto const data = file->data();
+            auto const size = file->size();
+            auto const header = static_cast<char const*>(std::memchr(data, '\n', size));
+            auto const header_end = header == nullptr ? size : static_cast<size_t>(header - data) + 1;
+            boundaries.assign(1, header_end);
+            for (size_t part = 1 ; part < part_count ; ++part) {
+                auto const position = std::max(boundaries.back(), size / part_count * part);
+                auto const line_end = position == 0 ? nullptr
+                        : static_cast<char const*>(std::memchr(data + position - 1, '\n', size - position + 1));
+                boundaries.push_back(line_end == nullptr ? size : static_cast<size_t>(line_end - data) + 1);
+            }
+            boundaries.push_back(size);
+        }
+
+        void read(size_t part, ds::value_by_id<ds::trip_ptr> const& trips, ds::value_by_id<ds::stop_ptr> const& stops,
+                stop_time_rows_t& rows) const {
+            if (part_count == 1) {
+                csv_reader<STOP_TIMES_COLUMN_COUNT> reader(path.string(), map_table(path.string()));
+                read_stop_times(reader, trips, stops, rows);
+                return;
+            }
+            csv_reader<STOP_TIMES_COLUMN_COUNT> reader(path.string(), file, file->data() + boundaries[part],
+                    file->data() + boundaries[part + 1]);
+            try {
+                read_stop_times(reader, trips, stops, rows);
+            } catch (io::error::with_file_line& error) {
+                // line numbers of a part start at its header, make them point into the whole file. The lines
+                // before the part are counted in a mapping of their own, the others are terminated already
+                if (error.file_line > 1) {
+                    io::MappedFile original(path.string());
+                    auto const lines_before = std::count(original.data() + boundaries.front(),
+                            original.data() + boundaries[part], '\n');
+                    error.set_file_line(error.file_line + static_cast<int>(lines_before));
+                }
+                throw;
+            }
+        }
+    };
+}
+
+namespace {
+    // what the feed occupies per entity type: its arena blocks and, for tables with ids, the id table. Child
+    // arrays are counted with the children
+    void print_memory_report(ds::feed_t const& feed) {
+        size_t total = 0;
+        auto print = [&](char const* name, size_t count, size_t bytes) {
+            total += bytes;
+            std::cout << "\t" << name << ": " << count << " entities, " << bytes << " bytes";
+            if (count != 0) {
+                std::cout << ", " << static_cast<double>(bytes) / count << " bytes each";
+            }
+            std::cout << std::endl;
+        };
+        size_t stop_time_bytes = 0;
+        for (auto const& arena : feed.stop_time_arenas) {
+            stop_time_bytes += arena.reserved();
+        }
+        std::cout << "Feed memory:" << std::endl;
+        print("agencies", feed.agencies.size(), feed.agency_arena.reserved() + feed.agencies.bytes());
+        print("routes", feed.routes.size(), feed.route_arena.reserved() + feed.routes.bytes());
+        print("services", feed.services.size(), feed.service_arena.reserved() + feed.services.bytes());
+        print("service exceptions", feed.service_exception_count, feed.service_exception_arena.reserved());
+        print("stops", feed.stops.size(), feed.stop_arena.reserved() + feed.stops.bytes());
+        print("transfers", feed.transfer_count, feed.transfer_arena.reserved());
+        print("trips", feed.trips.size(), feed.trip_arena.reserved() + feed.trips.bytes());
+        print("stop times", feed.stop_time_count, stop_time_bytes);
+        std::cout << "\tTotal: " << total << " bytes" << std::endl;
     }
 }
 
 namespace util {
-    processing::map_graph_t parse(std::string const& feed_directory) {
+    std::vector<ds::stop_time_ptr> parse_stop_times(std::string const& path, ds::feed_t& feed) {
+        if (feed.stop_time_arenas.empty()) {
+            feed.stop_time_arenas.resize(1);
+        }
+        stop_time_rows_t rows;
+        rows.arena = &feed.stop_time_arenas.front();
+        csv_reader<STOP_TIMES_COLUMN_COUNT> reader(path, map_table(path));
+        read_stop_times(reader, feed.trips, feed.stops, rows);
+        return std::move(rows.stop_times);
+    }
+
+    void link_stop_times(std::vector<std::vector<ds::stop_time_ptr>>& parts, ds::feed_t& feed) {
+        for (auto const& part : parts) {
+            feed.stop_time_count += part.size();
+        }
+        group_children<ds::stop_time_ptr>(feed.stop_time_arenas.front(), feed.stop_time_count,
+                [&](auto const& visit) {
+            for (auto const& part : parts) {
+                for (auto stop_time : part) {
+                    visit(stop_time);
+                }
+            }
+        }, [](ds::stop_time_ptr stop_time) -> ds::range_t<ds::stop_time_ptr>& {
+            return stop_time->trip->stop_times;
+        });
+        parts = {};
+    }
+
+    void sort_stop_times(ds::feed_t& feed) {
+        for (auto const& trip : feed.trips) {
+            std::sort(trip.second->stop_times.begin(), trip.second->stop_times.end(),
+                    [](ds::stop_time_ptr l, ds::stop_time_ptr r) {
+                return l->sequence < r->sequence;
+            });
+        }
+    }
+
+    ds::timetable_t parse(std::string const& feed_directory, unsigned threads, bool trip_transfers,
+            load_report_t* report) {
         if (!fs::is_directory(feed_directory)) {
             throw std::runtime_error("Feed directory is not directory: " + feed_directory);
         }
-        fs::path feed(feed_directory);
-        auto agencies = parse_agencies(get_table_path(feed, "agency.txt"));
-        std::cout << "Agencies count: " << agencies.size() << std::endl;
-        auto routes = parse_routes(get_table_path(feed, "routes.txt"), agencies);
-        std::cout << "Routes count: " << routes.size() << std::endl;
-        auto services = parse_regular_services(get_table_path(feed_directory, "calendar.txt"));
-        std::cout << "Regular services count: " << services.size() << std::endl;
-        fs::path exceptional_service_path;
-        if (try_get_table_path(feed, "calendar_dates.txt", exceptional_service_path)) {
-            parse_exceptional_services(exceptional_service_path, services);
-            std::cout << "Service exceptions added" << std::endl;
+        fs::path directory(feed_directory);
+        auto const agencies_path = get_table_path(directory, "agency.txt");
+        auto const routes_path = get_table_path(directory, "routes.txt");
+        auto const services_path = get_table_path(directory, "calendar.txt");
+        auto const stops_path = get_table_path(directory, "stops.txt");
+        auto const trips_path = get_table_path(directory, "trips.txt");
+        fs::path exceptional_services_path, transfers_path;
+
+        ds::feed_t feed;
+
+        stop_times_file_t stop_times_file;
+        stop_times_file.path = get_table_path(directory, "stop_times.txt");
+        stop_times_file.part_count = std::max(threads, 1u);
+        feed.stop_time_arenas.resize(stop_times_file.part_count);
+        std::vector<stop_time_rows_t> stop_time_parts(stop_times_file.part_count);
+        for (size_t part = 0 ; part < stop_time_parts.size() ; ++part) {
+            stop_time_parts[part].arena = &feed.stop_time_arenas[part];
         }
-        auto stops = parse_stops(get_table_path(feed, "stops.txt"));
-        std::cout << "Stops count: " << stops.size() << std::endl;
-        fs::path transfers_path;
-        if (try_get_table_path(feed, "transfers.txt", transfers_path)) {
-            parse_transfers(transfers_path, stops);
-            std::cout << "Transfers parsed" << std::endl;
+
+        // tables only wait for the tables they reference, stop_times.txt is read in parts in parallel and
+        // the parts are linked to trips and stops in file order, so the result does not depend on threads.
+        // the file is mapped and cut into parts while trips are parsed, its rows are resolved to trips and
+        // stops while reading
+        task_graph_t graph;
+        auto const agencies_task = graph.add("agency.txt", [&]() {
+            parse_agencies(agencies_path.string(), feed);
+        });
+        auto const routes_task = graph.add("routes.txt", [&]() {
+            parse_routes(routes_path.string(), feed);
+        }, {agencies_task});
+        auto const services_task = graph.add("calendar.txt", [&]() {
+            parse_regular_services(services_path.string(), feed);
+        });
+        if (try_get_table_path(directory, "calendar_dates.txt", exceptional_services_path)) {
+            graph.add("calendar_dates.txt", [&]() {
+                parse_exceptional_services(exceptional_services_path.string(), feed);
+            }, {services_task});
         }
-        auto trips = parse_trips(get_table_path(feed, "trips.txt"), routes, services);
-        std::cout << "Trips count: " << trips.size() << std::endl;
-        auto stop_times = parse_stop_times(get_table_path(feed, "stop_times.txt"), trips, stops);
-        std::cout << "Stop times count: " << stop_times.size() << std::endl;
-        std::cout << "Sorting stop times inside stops by departure time " << std::endl;
-        for (auto& stop : stops) {
-            std::sort(stop.second->stop_times.begin(), stop.second->stop_times.end(), ds::stop_time_cmp);
+        auto const stops_task = graph.add("stops.txt", [&]() {
+            parse_stops(stops_path.string(), feed);
+        });
+        if (try_get_table_path(directory, "transfers.txt", transfers_path)) {
+            graph.add("transfers.txt", [&]() {
+                parse_transfers(transfers_path.string(), feed);
+            }, {stops_task});
         }
-        std::cout << "Sorting stop times inside trips by sequence " << std::endl;
-        for (auto& trip : trips) {
-            std::sort(trip.second->stop_times.begin(), trip.second->stop_times.end(),
-                    [](ds::stop_time_ptr const& l, ds::stop_time_ptr const& r) {
-                return l->sequence < r->sequence;
+        auto const trips_task = graph.add("trips.txt", [&]() {
+            parse_trips(trips_path.string(), feed);
+        }, {routes_task, services_task});
+        auto const link_task = graph.add("stop_times.txt link", [&]() {
+            std::vector<std::vector<ds::stop_time_ptr>> parts;
+            for (auto& part : stop_time_parts) {
+                parts.push_back(std::move(part.stop_times));
+            }
+            stop_time_parts = {};
+            link_stop_times(parts, feed);
+        });
+        graph.add("stop_times.txt sort", [&]() {
+            sort_stop_times(feed);
+        }, {link_task});
+        auto load_task = ds::NO_INDEX;
+        if (stop_times_file.part_count > 1) {
+            load_task = graph.add("stop_times.txt load", [&]() {
+                stop_times_file.load();
             });
         }
-//        std::sort(stop_times.rbegin(), stop_times.rend(), ds::stop_time_cmp);
-//        std::cout << "Last ten departures by time: " << std::endl;
-//        for (size_t i = 0 ; i < 10 ; ++i) {
-//            std::cout << "\tarrival: " << stop_times.at(i)->arrival
-//            << " departure: " << stop_times.at(i)->departure << std::endl;
-//        }
-
-//        std::cout << "Some test data: " << std::endl;
-//        auto const& stop = stops.at("8503052");
-//        std::cout << stop->name << " name of our stop" << std::endl;
-//        for (auto const& stop_time : stop->stop_times) {
-//            const auto& trip = stop_time->trip;
-//            std::cout << "Next trip from station: " << std::endl;
-//            std::cout << "\tstarting at the : "<< stop_time->arrival  << std::endl;
-//            std::cout << "\thead sign for first trip: "<< trip->head_sign  << std::endl;
-//            std::cout << "\tand its type: " << trip->route->type << std::endl;
-//            std::cout << "\tand its description: " << trip->route->desc << std::endl;
-//       }
-//        std::cout << "Let's have some random trips printed out" << std::endl;
-//        print_trip(stop->stop_times.at(10)->trip);
-//        std::cout << std::endl << "And one more" << std::endl;
-//        print_trip(stop->stop_times.at(23)->trip);
-        return processing::map_graph_t(std::move(trips), std::move(stops), std::move(stop_times),
-                std::move(services), std::move(routes));
+        for (size_t part = 0 ; part < stop_time_parts.size() ; ++part) {
+            auto const read_task = graph.add("stop_times.txt read", [&, part]() {
+                stop_times_file.read(part, feed.trips, feed.stops, stop_time_parts[part]);
+            }, {trips_task, stops_task});
+            if (load_task != ds::NO_INDEX) {
+                graph.add_dependency(read_task, load_task);
+            }
+            graph.add_dependency(link_task, read_task);
+        }
+
+        auto const start = task_graph_t::clock_t::now();
+        graph.run(threads);
+        auto const elapsed = task_graph_t::clock_t::now() - start;
+
+        std::cout << "Agencies count: " << feed.agencies.size() << std::endl;
+        std::cout << "Routes count: " << feed.routes.size() << std::endl;
+        std::cout << "Regular services count: " << feed.services.size() << std::endl;
+        std::cout << "Stops count: " << feed.stops.size() << std::endl;
+        std::cout << "Trips count: " << feed.trips.size() << std::endl;
+        std::cout << "Stop times count: " << feed.stop_time_count << std::endl;
+        print_memory_report(feed);
+
+        // phases are the tasks of the graph under their names in the order they started, the parts reading
+        // stop_times.txt count the bytes of the whole file once
+        load_report_t local_report;
+        if (report == nullptr) {
+            report = &local_report;
+        }
+        report->threads = threads;
+        report->parse_wall = elapsed;
+        std::map<std::string, std::pair<fs::path, uint64_t>> tables = {
+            {"agency.txt", {agencies_path, feed.agencies.size()}},
+            {"routes.txt", {routes_path, feed.routes.size()}},
+            {"calendar.txt", {services_path, feed.services.size()}},
+            {"calendar_dates.txt", {exceptional_services_path, feed.service_exception_count}},
+            {"stops.txt", {stops_path, feed.stops.size()}},
+            {"transfers.txt", {transfers_path, feed.transfer_count}},
+            {"trips.txt", {trips_path, feed.trips.size()}},
+            {"stop_times.txt read", {stop_times_file.path, feed.stop_time_count}},
+        };
+        auto tasks = graph.get_tasks();
+        std::stable_sort(tasks.begin(), tasks.end(), [](task_graph_t::task_t const& l, task_graph_t::task_t const& r) {
+            return l.started < r.started;
+        });
+        for (auto const& task : tasks) {
+            auto& phase = report->phase(task.name);
+            if (phase.parts++ == 0) {
+                auto const table = tables.find(task.name);
+                if (table != tables.end()) {
+                    phase.bytes = fs::file_size(table->second.first);
+                    phase.rows = table->second.second;
+                } else if (task.name != "stop_times.txt load") {
+                    phase.rows = feed.stop_time_count;
+                }
+            }
+            phase.wall += task.elapsed;
+            phase.cpu += task.cpu;
+            phase.allocations += task.allocations;
+            phase.resident_growth += task.resident_growth;
+            report->parse_cpu += task.cpu;
+        }
+
+        // compiling runs on more threads for trip transfers, its cpu time is of the process and allocations
+        // are those of this thread
+        std::cout << "Compiling timetable" << std::endl;
+        ds::compile_options_t options;
+        options.threads = threads;
+        options.trip_transfers = trip_transfers;
+        auto const compile_start = task_graph_t::clock_t::now();
+        auto const compile_cpu_start = std::clock();
+        auto const compile_allocations_start = thread_allocations();
+        auto const compile_resident_start = resident_bytes();
+        auto timetable = ds::compile_timetable(feed.routes, feed.services, feed.stops, feed.trips, options);
+        auto& compile = report->phase("compile timetable");
+        compile.parts = 1;
+        compile.wall = task_graph_t::clock_t::now() - compile_start;
+        compile.cpu = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::duration<double>(static_cast<double>(std::clock() - compile_cpu_start) / CLOCKS_PER_SEC));
+        compile.allocations = thread_allocations() - compile_allocations_start;
+        compile.resident_growth = static_cast<int64_t>(resident_bytes()) - static_cast<int64_t>(compile_resident_start);
+        report->resident_bytes = resident_bytes();
+        if (trip_transfers) {
+            std::cout << "Trip transfers: " << timetable.trip_transfer_stop_times.size() << std::endl;
+        }
+        report->print(std::cout);
+        return timetable;
     }
 }
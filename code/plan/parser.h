@@ -1,14 +1,36 @@
 #ifndef PLAN_PARSER_T_H
 #define PLAN_PARSER_T_H
 
-#include "structures.h"
-#include "map_graph_t.h"
+#include "load_report_t.h"
+#include "timetable_t.h"
 
 #include <string>
+#include <vector>
 
 namespace util {
 
-processing::map_graph_t parse(std::string const& feed_directory);
+// independent tables are parsed concurrently and stop_times.txt is split between the threads, trip transfers
+// are computed on as many threads. The load report is printed and, when given, filled in
+data_structures::timetable_t parse(std::string const& feed_directory, unsigned threads = 1,
+        bool trip_transfers = false, load_report_t* report = nullptr);
+
+// The steps of parse on their own, for benchmarks. Every table needs the tables it references in feed already
+void parse_agencies(std::string const& path, data_structures::feed_t& feed);
+void parse_routes(std::string const& path, data_structures::feed_t& feed);
+void parse_regular_services(std::string const& path, data_structures::feed_t& feed);
+void parse_exceptional_services(std::string const& path, data_structures::feed_t& feed);
+void parse_stops(std::string const& path, data_structures::feed_t& feed);
+void parse_transfers(std::string const& path, data_structures::feed_t& feed);
+void parse_trips(std::string const& path, data_structures::feed_t& feed);
+
+// stop times of stop_times.txt in file order, read on one thread and not linked to their trips yet
+std::vector<data_structures::stop_time_ptr> parse_stop_times(std::string const& path, data_structures::feed_t& feed);
+
+// puts the stop times of parts, in file order, into the ranges of their trips. Parts are released
+void link_stop_times(std::vector<std::vector<data_structures::stop_time_ptr>>& parts, data_structures::feed_t& feed);
+
+// sorts the linked stop times of every trip by sequence
+void sort_stop_times(data_structures::feed_t& feed);
 
 } // util
 
@@ -0,0 +1,346 @@
+#include "map_graph_t.h"
+#include "memory_usage.h"
+#include "parser.h"
+#include "query_stats_t.h"
+#include "synthetic_feed.h"
+
+#include <benchmark/benchmark.h>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ds = data_structures;
+namespace fs = boost::filesystem;
+namespace po = boost::program_options;
+
+namespace {
+    constexpr size_t QUERY_COUNT = 1000;
+    constexpr int32_t QUERY_DAYS = 7;
+
+    struct query_t {
+        std::string start;
+        std::string finish;
+        ds::date_time_t departure;
+    };
+
+    // what the benchmarks share, built once before they run
+    struct setup_t {
+        std::string feed_directory;
+        std::unique_ptr<processing::map_graph_t> map;
+        std::vector<query_t> queries;
+    } setup;
+
+    // parser output would drown the results
+    class quiet_t {
+        std::ostringstream sink;
+        std::streambuf* saved;
+    public:
+        quiet_t() : saved(std::cout.rdbuf(sink.rdbuf())) {
+        }
+
+        ~quiet_t() {
+            std::cout.rdbuf(saved);
+        }
+    };
+
+    // removes the synthetic feed directory however the benchmarks end
+    class generated_feed_t {
+        fs::path directory;
+    public:
+        explicit generated_feed_t(fs::path directory) : directory(std::move(directory)) {
+        }
+
+        generated_feed_t(generated_feed_t const&) = delete;
+        generated_feed_t& operator=(generated_feed_t const&) = delete;
+
+        ~generated_feed_t() {
+            boost::system::error_code error;
+            fs::remove_all(directory, error);
+        }
+
+        std::string string() const {
+            return directory.string();
+        }
+    };
+
+    // counted only when built with PLANNER_ALLOCATION_COUNTS
+    void set_allocations(benchmark::State& state, size_t count) {
+        if (!util::ALLOCATION_COUNTS) {
+            return;
+        }
+        state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(count),
+                benchmark::Counter::kAvgIterations);
+    }
+
+    using table_parser_t = std::function<void(ds::feed_t&)>;
+
+    table_parser_t table_parser(void (*parse)(std::string const&, ds::feed_t&), char const* table) {
+        auto const path = (fs::path(setup.feed_directory) / table).string();
+        return [parse, path](ds::feed_t& feed) {
+            parse(path, feed);
+        };
+    }
+
+    // Parses table into a fresh feed every iteration, the tables it references are parsed untimed before.
+    // Throughput is in rows of the table
+    void parse_table(benchmark::State& state, std::vector<table_parser_t> const& references,
+            table_parser_t const& parse, std::function<size_t(ds::feed_t const&)> const& rows) {
+        size_t allocated = 0;
+        size_t items = 0;
+        for (auto _ : state) {
+            state.PauseTiming();
+            {
+                ds::feed_t feed;
+                for (auto const& reference : references) {
+                    reference(feed);
+                }
+                state.ResumeTiming();
+                auto const before = util::thread_allocations();
+                parse(feed);
+                allocated += util::thread_allocations() - before;
+                state.PauseTiming();
+                items += rows(feed);
+            }
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(items));
+        set_allocations(state, allocated);
+    }
+
+    void register_parse_benchmarks() {
+        auto const agencies = table_parser(util::parse_agencies, "agency.txt");
+        auto const routes = table_parser(util::parse_routes, "routes.txt");
+        auto const services = table_parser(util::parse_regular_services, "calendar.txt");
+        auto const exceptions = table_parser(util::parse_exceptional_services, "calendar_dates.txt");
+        auto const stops = table_parser(util::parse_stops, "stops.txt");
+        auto const transfers = table_parser(util::parse_transfers, "transfers.txt");
+        auto const trips = table_parser(util::parse_trips, "trips.txt");
+        auto const stop_times_path = (fs::path(setup.feed_directory) / "stop_times.txt").string();
+
+        benchmark::RegisterBenchmark("parse/agency.txt", parse_table, std::vector<table_parser_t>(), agencies,
+                [](ds::feed_t const& feed) {
+            return feed.agencies.size();
+        });
+        benchmark::RegisterBenchmark("parse/routes.txt", parse_table, std::vector<table_parser_t>{agencies}, routes,
+                [](ds::feed_t const& feed) {
+            return feed.routes.size();
+        });
+        benchmark::RegisterBenchmark("parse/calendar.txt", parse_table, std::vector<table_parser_t>(), services,
+                [](ds::feed_t const& feed) {
+            return feed.services.size();
+        });
+        benchmark::RegisterBenchmark("parse/calendar_dates.txt", parse_table, std::vector<table_parser_t>{services},
+                exceptions, [](ds::feed_t const& feed) {
+            return feed.service_exception_count;
+        });
+        benchmark::RegisterBenchmark("parse/stops.txt", parse_table, std::vector<table_parser_t>(), stops,
+                [](ds::feed_t const& feed) {
+            return feed.stops.size();
+        });
+        benchmark::RegisterBenchmark("parse/transfers.txt", parse_table, std::vector<table_parser_t>{stops},
+                transfers, [](ds::feed_t const& feed) {
+            return feed.transfer_count;
+        });
+        benchmark::RegisterBenchmark("parse/trips.txt", parse_table,
+                std::vector<table_parser_t>{agencies, routes, services}, trips, [](ds::feed_t const& feed) {
+            return feed.trips.size();
+        });
+        benchmark::RegisterBenchmark("parse/stop_times.txt", [=](benchmark::State& state) {
+            std::vector<ds::stop_time_ptr> rows;
+            parse_table(state, {agencies, routes, services, stops, trips}, [&](ds::feed_t& feed) {
+                rows = util::parse_stop_times(stop_times_path, feed);
+            }, [&](ds::feed_t const&) {
+                return rows.size();
+            });
+        });
+        // the steps after reading: stop times grouped by trip, then ordered by sequence
+        benchmark::RegisterBenchmark("parse/link_stop_times", [=](benchmark::State& state) {
+            std::vector<std::vector<ds::stop_time_ptr>> parts;
+            parse_table(state, {agencies, routes, services, stops, trips, [&](ds::feed_t& feed) {
+                parts.assign(1, util::parse_stop_times(stop_times_path, feed));
+            }}, [&](ds::feed_t& feed) {
+                util::link_stop_times(parts, feed);
+            }, [](ds::feed_t const& feed) {
+                return feed.stop_time_count;
+            });
+        });
+        benchmark::RegisterBenchmark("parse/sort_stop_times", [=](benchmark::State& state) {
+            std::vector<std::vector<ds::stop_time_ptr>> parts;
+            parse_table(state, {agencies, routes, services, stops, trips, [&](ds::feed_t& feed) {
+                parts.assign(1, util::parse_stop_times(stop_times_path, feed));
+                util::link_stop_times(parts, feed);
+            }}, [](ds::feed_t& feed) {
+                util::sort_stop_times(feed);
+            }, [](ds::feed_t const& feed) {
+                return feed.stop_time_count;
+            });
+        });
+        benchmark::RegisterBenchmark("parse/feed", [](benchmark::State& state) {
+            size_t allocated = 0;
+            for (auto _ : state) {
+                quiet_t quiet;
+                auto const before = util::thread_allocations();
+                benchmark::DoNotOptimize(util::parse(setup.feed_directory, 1));
+                allocated += util::thread_allocations() - before;
+            }
+            set_allocations(state, allocated);
+        })->Unit(benchmark::kMillisecond);
+    }
+
+    // stops and times Dijkstra settles on its way, at random
+    void next_stops(benchmark::State& state) {
+        auto const& timetable = setup.map->get_timetable();
+        std::mt19937 random(1);
+        std::uniform_int_distribution<uint32_t> stop(0, static_cast<uint32_t>(timetable.stop_count() - 1));
+        std::uniform_int_distribution<ds::seconds_t> time(0, ds::DAY_SECONDS - 1);
+        auto const query_day = boost::gregorian::date(2019, 6, 12).day_number();
+        std::vector<std::pair<int32_t, uint32_t>> result;
+        processing::query_stats_t stats;
+        size_t allocated = 0;
+        size_t boarded = 0;
+        for (auto _ : state) {
+            state.PauseTiming();
+            auto const next_stop = stop(random);
+            auto const next_time = time(random);
+            state.ResumeTiming();
+            auto const before = util::thread_allocations();
+            processing::get_next_stops(result, timetable, next_stop, static_cast<int32_t>(query_day), next_time,
+                    stats);
+            allocated += util::thread_allocations() - before;
+            boarded += result.size();
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        state.counters["boarded/op"] = benchmark::Counter(static_cast<double>(boarded),
+                benchmark::Counter::kAvgIterations);
+        set_allocations(state, allocated);
+    }
+
+    // one random query of a fixed list per iteration on a warm context, latency percentiles in microseconds
+    void journey(benchmark::State& state, processing::engine_t engine) {
+        processing::query_context_t context;
+        std::vector<double> latencies;
+        size_t allocated = 0;
+        size_t found = 0;
+        size_t next = 0;
+        for (auto _ : state) {
+            auto const& query = setup.queries[next++ % setup.queries.size()];
+            auto const before = util::thread_allocations();
+            auto const started = std::chrono::steady_clock::now();
+            try {
+                benchmark::DoNotOptimize(setup.map->journey(query.start, query.finish, query.departure, context,
+                        engine));
+                ++found;
+            } catch (std::runtime_error const&) {
+            }
+            latencies.push_back(std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - started).count());
+            allocated += util::thread_allocations() - before;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations()));
+        state.counters["found"] = benchmark::Counter(static_cast<double>(found), benchmark::Counter::kAvgIterations);
+        state.counters["p50_us"] = processing::percentile(latencies, 0.5);
+        state.counters["p90_us"] = processing::percentile(latencies, 0.9);
+        state.counters["p99_us"] = processing::percentile(latencies, 0.99);
+        set_allocations(state, allocated);
+    }
+
+    void register_query_benchmarks() {
+        benchmark::RegisterBenchmark("get_next_stops", next_stops);
+        for (auto const& name : {"dijkstra", "astar", "raptor", "csa", "trip_based"}) {
+            benchmark::RegisterBenchmark((std::string("journey/") + name).c_str(), journey,
+                    processing::engine_from_string(name))->Unit(benchmark::kMicrosecond);
+        }
+    }
+
+    // random pairs of distinct stops at random times of a week of the feed
+    std::vector<query_t> make_queries(ds::timetable_t const& timetable) {
+        std::mt19937 random(1);
+        std::uniform_int_distribution<uint32_t> stop(0, static_cast<uint32_t>(timetable.stop_count() - 1));
+        std::uniform_int_distribution<int32_t> day(0, QUERY_DAYS - 1);
+        std::uniform_int_distribution<int32_t> time(6 * 60 * 60, 22 * 60 * 60);
+        std::vector<query_t> queries;
+        while (queries.size() < QUERY_COUNT) {
+            auto const start = stop(random);
+            auto const finish = stop(random);
+            if (start == finish) {
+                continue;
+            }
+            auto const date = boost::gregorian::date(2019, 6, 10) + boost::gregorian::days(day(random));
+            queries.push_back(query_t{timetable.stop_ids[start].to_string(), timetable.stop_ids[finish].to_string(),
+                    ds::date_time_t(date, boost::posix_time::seconds(time(random)))});
+        }
+        return queries;
+    }
+}
+
+// Options of the synthetic feed come first, everything else goes to the benchmark library, for example
+// --benchmark_filter=journey
+int main(int argc, char** argv) {
+    util::synthetic_feed_options_t feed_options;
+    po::options_description desc("Options");
+    desc.add_options()
+            ("feed_directory", po::value<std::string>(), "Benchmark this feed instead of a synthetic one")
+            ("stops", po::value<uint32_t>(&feed_options.stops), "Stops of the synthetic feed")
+            ("routes", po::value<uint32_t>(&feed_options.routes), "Routes of the synthetic feed")
+            ("trips_per_day", po::value<uint32_t>(&feed_options.trips_per_day), "Trips of the synthetic feed")
+            ("transfers_per_stop", po::value<double>(&feed_options.transfers_per_stop),
+                    "Footpaths from every stop of the synthetic feed")
+            ("seed", po::value<uint32_t>(&feed_options.seed), "Random seed of the synthetic feed")
+            ("help", "Print help messages");
+    po::variables_map vm;
+    auto const parsed = po::command_line_parser(argc, argv).options(desc).allow_unregistered().run();
+    po::store(parsed, vm);
+    if (vm.count("help")) {
+        std::cout << desc << std::endl;
+        benchmark::PrintDefaultHelp();
+        return 0;
+    }
+    try {
+        po::notify(vm);
+        std::unique_ptr<generated_feed_t> generated;
+        if (vm.count("feed_directory")) {
+            setup.feed_directory = vm["feed_directory"].as<std::string>();
+        } else {
+            generated.reset(new generated_feed_t(fs::temp_directory_path()
+                    / fs::unique_path("planner-bench-%%%%-%%%%")));
+            setup.feed_directory = generated->string();
+            util::write_synthetic_feed(setup.feed_directory, feed_options);
+        }
+        {
+            quiet_t quiet;
+            setup.map.reset(new processing::map_graph_t(util::parse(setup.feed_directory, 1, true)));
+        }
+        setup.queries = make_queries(setup.map->get_timetable());
+        register_parse_benchmarks();
+        register_query_benchmarks();
+
+        auto arguments = po::collect_unrecognized(parsed.options, po::include_positional);
+        std::vector<char*> benchmark_argv{argv[0]};
+        for (auto& argument : arguments) {
+            benchmark_argv.push_back(&argument[0]);
+        }
+        auto benchmark_argc = static_cast<int>(benchmark_argv.size());
+        benchmark::Initialize(&benchmark_argc, benchmark_argv.data());
+        if (benchmark::ReportUnrecognizedArguments(benchmark_argc, benchmark_argv.data())) {
+            return 1;
+        }
+        benchmark::RunSpecifiedBenchmarks();
+        benchmark::Shutdown();
+    } catch (std::exception const& e) {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "query_context_t.h"
+
+namespace ds = data_structures;
+
+namespace processing {
+
+    constexpr int32_t query_context_t::dijkstra_state_t::PREVIOUS_DAYS;
+    constexpr size_t query_context_t::trip_based_state_t::KEPT_DAYS;
+
+    void query_context_t::dijkstra_state_t::reset(ds::timetable_t const& timetable) {
+        auto const stop_count = timetable.stop_count();
+        if (visited.size() != stop_count) {
+            visited.assign(stop_count, ds::path_leg_t());
+            parents.assign(stop_count, ds::NO_INDEX);
+        }
+        settled.reset(stop_count);
+        bounds.reset(stop_count, 0);
+        // days grown by earlier queries are kept while the timetable stays the same
+        auto const trips = timetable.trip_count();
+        auto const size = trips == trip_count ? boarded_trips.size() : size_t(trips) * (PREVIOUS_DAYS + 2);
+        trip_count = trips;
+        boarded_trips.reset(size, ds::NO_INDEX);
+        queue.clear();
+    }
+
+    uint32_t& query_context_t::dijkstra_state_t::boarded_trip(uint32_t trip, int32_t day) {
+        auto const index = static_cast<size_t>(day + PREVIOUS_DAYS) * trip_count + trip;
+        boarded_trips.grow(index - trip + trip_count);
+        return boarded_trips.set(index);
+    }
+
+    void query_context_t::csa_state_t::reset(ds::timetable_t const& timetable, int32_t first_scanned_day) {
+        auto const stop_count = timetable.stop_count();
+        arrivals.reset(stop_count, INFINITE_TIME);
+        labels.reset(stop_count, csa_label_t());
+        auto const trips = timetable.trip_count();
+        auto const size = trips == trip_count ? trip_entries.size() : size_t(trips) * 2;
+        trip_count = trips;
+        trip_entries.reset(size, ds::NO_INDEX);
+        first_day = first_scanned_day;
+        walks.clear();
+        cursors.clear();
+    }
+
+    void query_context_t::csa_state_t::open_day(int32_t day) {
+        trip_entries.grow(static_cast<size_t>(day - first_day + 1) * trip_count);
+    }
+
+    void query_context_t::trip_based_state_t::reset(ds::timetable_t const& timetable, size_t slots,
+            int32_t first_reached_day) {
+        auto const stop_count = timetable.stop_count();
+        final_walks.reset(stop_count, std::make_pair(INFINITE_TIME, ds::NO_INDEX));
+        arrivals.reset(stop_count, INFINITE_TIME);
+        alightings.reset(stop_count, INFINITE_TIME);
+        // days grown by earlier queries are kept while the timetable stays the same, up to KEPT_DAYS of them
+        auto const size = slots == slot_count && reached_ranks.size() <= slots * KEPT_DAYS ? reached_ranks.size()
+                : slots * 2;
+        slot_count = slots;
+        reached_ranks.reset(size, ds::NO_INDEX);
+        first_day = first_reached_day;
+        segments.clear();
+    }
+
+    void query_context_t::trip_based_state_t::reach(size_t slot, int32_t day, uint32_t rank) {
+        auto const index = static_cast<size_t>(day - first_day) * slot_count + slot;
+        reached_ranks.grow(index - slot + slot_count);
+        auto& reached = reached_ranks.set(index);
+        reached = std::min(reached, rank);
+    }
+
+    void query_context_t::raptor_state_t::reset(ds::timetable_t const& timetable, size_t pattern_count) {
+        auto const stop_count = timetable.stop_count();
+        best.reset(stop_count, INFINITE_TIME);
+        latest.reset(stop_count, raptor_label_t());
+        if (pattern_from.size() != pattern_count) {
+            pattern_from.assign(pattern_count, ds::NO_INDEX);
+        }
+        start_run();
+    }
+
+    void query_context_t::raptor_state_t::start_run() {
+        previous.reset(best.size(), INFINITE_TIME);
+        round_count = 0;
+        marked.clear();
+        queued_patterns.clear();
+    }
+
+    generation_array_t<raptor_label_t>& query_context_t::raptor_state_t::add_round() {
+        if (round_count == rounds.size()) {
+            rounds.emplace_back();
+        }
+        auto& labels = rounds[round_count++];
+        labels.reset(best.size(), raptor_label_t());
+        return labels;
+    }
+}
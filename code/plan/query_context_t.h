@@ -0,0 +1,250 @@
+#ifndef PLANNER_QUERY_CONTEXT_T_H
+#define PLANNER_QUERY_CONTEXT_T_H
+
+#include "query_stats_t.h"
+#include "timetable_t.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace processing {
+
+    constexpr data_structures::seconds_t INFINITE_TIME = std::numeric_limits<data_structures::seconds_t>::max();
+
+    // Array whose elements read as the fallback value until they are written in the current generation.
+    // Starting a new generation forgets all writes at once without touching the elements
+    template<typename T>
+    class generation_array_t {
+        std::vector<T> values;
+        std::vector<uint32_t> generations;
+        uint32_t generation = 1;
+        T fallback = T();
+    public:
+        // starts a new generation of size elements, only allocates when the size changes
+        void reset(size_t size, T const& fallback_value) {
+            fallback = fallback_value;
+            if (size != values.size()) {
+                // fresh vectors, a smaller size gives the memory back
+                std::vector<T>(size, fallback).swap(values);
+                std::vector<uint32_t>(size, 0).swap(generations);
+                generation = 1;
+            } else if (++generation == 0) {
+                std::fill(generations.begin(), generations.end(), 0);
+                generation = 1;
+            }
+        }
+
+        // adds elements that read as the fallback, elements already written keep their values
+        void grow(size_t size) {
+            if (size > values.size()) {
+                values.resize(size, fallback);
+                generations.resize(size, 0);
+            }
+        }
+
+        bool is_set(size_t i) const {
+            return generations[i] == generation;
+        }
+
+        T const& operator[](size_t i) const {
+            return is_set(i) ? values[i] : fallback;
+        }
+
+        // element to write, it holds the fallback when it was not written in this generation yet
+        T& set(size_t i) {
+            if (!is_set(i)) {
+                generations[i] = generation;
+                values[i] = fallback;
+            }
+            return values[i];
+        }
+
+        size_t size() const {
+            return values.size();
+        }
+    };
+
+    // Set of dense indices emptied by starting a new generation
+    class generation_set_t {
+        std::vector<uint32_t> generations;
+        uint32_t generation = 1;
+    public:
+        void reset(size_t size) {
+            if (size != generations.size()) {
+                generations.assign(size, 0);
+                generation = 1;
+            } else if (++generation == 0) {
+                std::fill(generations.begin(), generations.end(), 0);
+                generation = 1;
+            }
+        }
+
+        bool contains(size_t i) const {
+            return generations[i] == generation;
+        }
+
+        // false when i was already in the set
+        bool insert(size_t i) {
+            if (contains(i)) {
+                return false;
+            }
+            generations[i] = generation;
+            return true;
+        }
+    };
+
+    struct dijkstra_entry_t {
+        data_structures::seconds_t estimate; // arrival at the target through destination, time for Dijkstra
+        data_structures::seconds_t time;
+        uint32_t destination;
+        uint32_t source;
+        uint32_t transfer;
+        uint32_t transport;
+
+        // heap order, ties are broken by destination only
+        bool operator>(dijkstra_entry_t const& that) const {
+            return estimate != that.estimate ? estimate > that.estimate : destination > that.destination;
+        }
+    };
+
+    struct raptor_label_t {
+        data_structures::seconds_t arrival = INFINITE_TIME;
+        uint32_t from = data_structures::NO_INDEX; // stop where the trip was boarded or the footpath started
+        uint32_t pattern = data_structures::NO_INDEX; // NO_INDEX for footpaths
+        uint32_t trip_or_footpath = data_structures::NO_INDEX; // trip position in the pattern or transfer index
+        uint16_t position = 0;
+        int16_t day = 0;
+    };
+
+    struct csa_label_t {
+        uint32_t from = data_structures::NO_INDEX; // stop where the trip was boarded or the footpath started
+        uint32_t exit = data_structures::NO_INDEX; // connection leaving the trip, NO_INDEX for footpaths
+        uint32_t transfer = data_structures::NO_INDEX;
+    };
+
+    struct trip_segment_t {
+        uint32_t trip;
+        int32_t day;
+        uint32_t begin; // position boarded at
+        uint32_t end; // last position reached by this segment
+        uint32_t parent = data_structures::NO_INDEX; // segment alighted from, NO_INDEX for the first trip
+        uint32_t alighted = 0; // position alighted at in the parent
+        uint32_t walk = data_structures::NO_INDEX; // footpath from the source to the first trip
+    };
+
+    // Scratch memory of the routing engines, sized to the timetable on first use and reused by every following
+    // query. Per stop and per trip state is forgotten through generations instead of clearing, so a query on
+    // a warm context allocates nothing but its result. Not shared: every thread routes with its own context
+    struct query_context_t {
+        // of the last journey or earliest arrivals query
+        query_stats_t stats;
+
+        struct dijkstra_state_t {
+            // trips of this many service days before the day of a stop may still be running there
+            static constexpr int32_t PREVIOUS_DAYS = 3;
+
+            // legs and parents are only read for settled stops and need no reset
+            std::vector<data_structures::path_leg_t> visited;
+            std::vector<uint32_t> parents;
+            generation_set_t settled;
+            // first queued stop time of every boarded trip instance, day major so further days are appended
+            generation_array_t<uint32_t> boarded_trips;
+            uint32_t trip_count = 0;
+            std::vector<dijkstra_entry_t> queue;
+            std::vector<std::pair<int32_t, uint32_t>> next_stops;
+            // A* bound of every queued stop to the target
+            generation_array_t<data_structures::seconds_t> bounds;
+
+            void reset(data_structures::timetable_t const& timetable);
+
+            // NO_INDEX when the trip instance of the service day, an offset from the query day, is not boarded
+            uint32_t& boarded_trip(uint32_t trip, int32_t day);
+        } dijkstra;
+
+        struct raptor_state_t {
+            // labels of every round, only the first round_count are used by the running query
+            std::vector<generation_array_t<raptor_label_t>> rounds;
+            size_t round_count = 0;
+            generation_array_t<data_structures::seconds_t> best;
+            // label that last improved every stop, profile queries unwind these because their runs share best
+            generation_array_t<raptor_label_t> latest;
+            generation_array_t<data_structures::seconds_t> previous;
+            std::vector<uint32_t> marked;
+            // first position to scan of every queued pattern, NO_INDEX again once the pattern is scanned
+            std::vector<uint32_t> pattern_from;
+            std::vector<uint32_t> queued_patterns;
+
+            void reset(data_structures::timetable_t const& timetable, size_t pattern_count);
+
+            // forgets rounds and marks of the previous run but keeps best and latest
+            void start_run();
+
+            generation_array_t<raptor_label_t>& add_round();
+        } raptor;
+
+        struct csa_state_t {
+            generation_array_t<data_structures::seconds_t> arrivals;
+            generation_array_t<csa_label_t> labels;
+            // connection every trip instance was boarded with, day major from the first scanned service day
+            generation_array_t<uint32_t> trip_entries;
+            uint32_t trip_count = 0;
+            int32_t first_day = 0;
+            // stops whose footpaths are still to relax
+            std::vector<uint32_t> walks;
+            // next connection of every scanned service day
+            std::vector<std::pair<int32_t, size_t>> cursors;
+
+            void reset(data_structures::timetable_t const& timetable, int32_t first_day);
+
+            // makes room for the trips of a service day, an offset from the query day
+            void open_day(int32_t day);
+
+            // NO_INDEX when the trip instance of an open service day is not boarded
+            uint32_t trip_entry(uint32_t trip, int32_t day) const {
+                return trip_entries[static_cast<size_t>(day - first_day) * trip_count + trip];
+            }
+
+            void board(uint32_t trip, int32_t day, uint32_t connection) {
+                trip_entries.set(static_cast<size_t>(day - first_day) * trip_count + trip) = connection;
+            }
+        } csa;
+
+        struct trip_based_state_t {
+            // days of reached ranks kept for the next query, a search reaching further gives the rest back
+            static constexpr size_t KEPT_DAYS = 8;
+
+            // lowest rank in its pattern of the trips reached at every stop of every pattern, day major from the
+            // first service day boarded. A trip is reached from the first stop some trip up to its rank was
+            generation_array_t<uint32_t> reached_ranks;
+            size_t slot_count = 0;
+            int32_t first_day = 0;
+            // duration and footpath of the walk to the target from every stop
+            generation_array_t<std::pair<data_structures::seconds_t, uint32_t>> final_walks;
+            // earliest arrival at every stop, by a trip or a footpath after it
+            generation_array_t<data_structures::seconds_t> arrivals;
+            // earliest arrival at every stop by a trip or from the source, one footpath may still follow
+            generation_array_t<data_structures::seconds_t> alightings;
+            // every level of the search follows the one before it
+            std::vector<trip_segment_t> segments;
+
+            // slots are the stops of all patterns one after another
+            void reset(data_structures::timetable_t const& timetable, size_t slot_count, int32_t first_day);
+
+            // NO_INDEX when no trip of the pattern was reached at the slot on the service day, an offset from the
+            // query day
+            uint32_t reached_rank(size_t slot, int32_t day) const {
+                auto const index = static_cast<size_t>(day - first_day) * slot_count + slot;
+                return index < reached_ranks.size() ? reached_ranks[index] : data_structures::NO_INDEX;
+            }
+
+            void reach(size_t slot, int32_t day, uint32_t rank);
+        } trip_based;
+    };
+
+}
+
+#endif //PLANNER_QUERY_CONTEXT_T_H
@@ -0,0 +1,81 @@
+#include "query_stats_t.h"
+
+#include <algorithm>
+
+namespace {
+    double milliseconds(std::chrono::nanoseconds duration) {
+        return std::chrono::duration<double, std::milli>(duration).count();
+    }
+
+    int64_t nanoseconds(processing::query_stats_t::clock_t::duration duration) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    }
+}
+
+namespace processing {
+
+    std::ostream& operator<<(std::ostream& out, query_stats_t const& stats) {
+        return out << "settled " << stats.settled << ", pushes " << stats.pushes << ", pops " << stats.pops
+                << ", stale pops " << stats.stale_pops << ", peak queue " << stats.peak_queue << ", trips scanned "
+                << stats.trips_scanned << ", stop times " << stats.stop_times << ", services rejected "
+                << stats.services_rejected << ", reset " << milliseconds(stats.reset_time) << " ms, search "
+                << milliseconds(stats.search_time) << " ms, unwind " << milliseconds(stats.unwind_time) << " ms";
+    }
+
+    void query_stats_total_t::add(query_stats_t const& stats) {
+        queries.fetch_add(1, std::memory_order_relaxed);
+        settled.fetch_add(stats.settled, std::memory_order_relaxed);
+        pushes.fetch_add(stats.pushes, std::memory_order_relaxed);
+        pops.fetch_add(stats.pops, std::memory_order_relaxed);
+        stale_pops.fetch_add(stats.stale_pops, std::memory_order_relaxed);
+        auto peak = peak_queue.load(std::memory_order_relaxed);
+        while (stats.peak_queue > peak && !peak_queue.compare_exchange_weak(peak, stats.peak_queue,
+                std::memory_order_relaxed)) {
+        }
+        trips_scanned.fetch_add(stats.trips_scanned, std::memory_order_relaxed);
+        stop_times.fetch_add(stats.stop_times, std::memory_order_relaxed);
+        services_rejected.fetch_add(stats.services_rejected, std::memory_order_relaxed);
+        reset_nanoseconds.fetch_add(nanoseconds(stats.reset_time), std::memory_order_relaxed);
+        search_nanoseconds.fetch_add(nanoseconds(stats.search_time), std::memory_order_relaxed);
+        unwind_nanoseconds.fetch_add(nanoseconds(stats.unwind_time), std::memory_order_relaxed);
+    }
+
+    void query_stats_total_t::print(std::ostream& out) const {
+        auto const count = queries.load(std::memory_order_relaxed);
+        auto const per_query = static_cast<double>(std::max<uint64_t>(count, 1));
+        auto print = [&](char const* name, uint64_t total) {
+            out << "\t" << name << ": " << total << ", " << total / per_query << " per query" << std::endl;
+        };
+        auto print_time = [&](char const* name, int64_t total) {
+            auto const duration = std::chrono::nanoseconds(total);
+            out << "\t" << name << ": " << milliseconds(duration) << " ms, " << milliseconds(duration) / per_query
+                    << " ms per query" << std::endl;
+        };
+        out << "Query stats of " << count << " queries:" << std::endl;
+        print("settled", settled.load(std::memory_order_relaxed));
+        print("pushes", pushes.load(std::memory_order_relaxed));
+        print("pops", pops.load(std::memory_order_relaxed));
+        print("stale pops", stale_pops.load(std::memory_order_relaxed));
+        out << "\tpeak queue: " << peak_queue.load(std::memory_order_relaxed) << std::endl;
+        print("trips scanned", trips_scanned.load(std::memory_order_relaxed));
+        print("stop times", stop_times.load(std::memory_order_relaxed));
+        print("services rejected", services_rejected.load(std::memory_order_relaxed));
+        print_time("reset", reset_nanoseconds.load(std::memory_order_relaxed));
+        print_time("search", search_nanoseconds.load(std::memory_order_relaxed));
+        print_time("unwind", unwind_nanoseconds.load(std::memory_order_relaxed));
+    }
+
+    query_stats_total_t& process_query_stats() {
+        static query_stats_total_t total;
+        return total;
+    }
+
+    double percentile(std::vector<double> const& sorted, double fraction) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        auto const rank = static_cast<size_t>(fraction * sorted.size() + 0.5);
+        return sorted[std::min(sorted.size(), std::max<size_t>(rank, 1)) - 1];
+    }
+
+}
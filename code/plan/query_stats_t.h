@@ -0,0 +1,72 @@
+#ifndef PLANNER_QUERY_STATS_T_H
+#define PLANNER_QUERY_STATS_T_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+// Counting is compiled in with -DPLANNER_QUERY_STATS (cmake -DPLANNER_QUERY_STATS=ON). Without it the statements
+// in QUERY_STATS vanish and the stats of every query stay zero
+#ifdef PLANNER_QUERY_STATS
+#define QUERY_STATS(...) __VA_ARGS__
+#else
+#define QUERY_STATS(...)
+#endif
+
+namespace processing {
+
+    // What one query did. Queue and stop time counters are kept by the dijkstra and astar engines, the other
+    // engines only time their search
+    struct query_stats_t {
+        using clock_t = std::chrono::steady_clock;
+
+        uint64_t settled = 0;
+        uint64_t pushes = 0;
+        uint64_t pops = 0;
+        uint64_t stale_pops = 0; // popped for stops settled before
+        uint64_t peak_queue = 0;
+        uint64_t trips_scanned = 0; // trip instances boarded
+        uint64_t stop_times = 0; // examined while looking for the trips to board
+        uint64_t services_rejected = 0; // stop times of trips not running on the service day
+        clock_t::duration reset_time = clock_t::duration::zero();
+        clock_t::duration search_time = clock_t::duration::zero();
+        clock_t::duration unwind_time = clock_t::duration::zero();
+
+        void clear() {
+            *this = query_stats_t();
+        }
+    };
+
+    std::ostream& operator<<(std::ostream& out, query_stats_t const& stats);
+
+    // Sums of the stats of all queries of the process, safe to add to from every query thread
+    class query_stats_total_t {
+        std::atomic<uint64_t> queries{0};
+        std::atomic<uint64_t> settled{0};
+        std::atomic<uint64_t> pushes{0};
+        std::atomic<uint64_t> pops{0};
+        std::atomic<uint64_t> stale_pops{0};
+        std::atomic<uint64_t> peak_queue{0}; // largest of all queries
+        std::atomic<uint64_t> trips_scanned{0};
+        std::atomic<uint64_t> stop_times{0};
+        std::atomic<uint64_t> services_rejected{0};
+        std::atomic<int64_t> reset_nanoseconds{0};
+        std::atomic<int64_t> search_nanoseconds{0};
+        std::atomic<int64_t> unwind_nanoseconds{0};
+    public:
+        void add(query_stats_t const& stats);
+
+        // totals and averages per query
+        void print(std::ostream& out) const;
+    };
+
+    query_stats_total_t& process_query_stats();
+
+    // the value of sorted a fraction of the values are at or below, by nearest rank; 0 without values
+    double percentile(std::vector<double> const& sorted, double fraction);
+
+}
+
+#endif //PLANNER_QUERY_STATS_T_H
@@ -0,0 +1,322 @@
+#include "raptor_t.h"
+
+#include <algorithm>
+#include <exception>
+#include <functional>
+#include <utility>
+
+namespace ds = data_structures;
+
+namespace processing {
+
+    raptor_t::raptor_t(ds::timetable_t const& timetable) : max_day_span(0) {
+        for (auto departure : timetable.pattern_departures) {
+            max_day_span = std::max(max_day_span, departure / ds::DAY_SECONDS);
+        }
+    }
+
+    void raptor_t::route(ds::timetable_t const& timetable, uint32_t source, uint32_t target,
+            int32_t query_day_number, ds::seconds_t departure, query_context_t::raptor_state_t& context,
+            uint32_t max_trips) const {
+        auto& best = context.best;
+        auto& previous = context.previous;
+        auto& marked = context.marked;
+        auto& pattern_from = context.pattern_from;
+        auto& queued_patterns = context.queued_patterns;
+        using labels_t = generation_array_t<label_t>;
+
+        auto improve = [&](labels_t& labels, uint32_t stop, label_t const& label) {
+            if (label.arrival >= best[stop] || (target != ds::NO_INDEX && label.arrival >= best[target])) {
+                return false;
+            }
+            labels.set(stop) = label;
+            context.latest.set(stop) = label;
+            best.set(stop) = label.arrival;
+            marked.push_back(stop);
+            return true;
+        };
+
+        auto relax_footpaths = [&](labels_t& labels) {
+            for (size_t i = 0 ; i < marked.size() ; ++i) {
+                auto const from = marked[i];
+                for (auto transfer = timetable.stop_transfers_begin[from] ;
+                        transfer < timetable.stop_transfers_begin[from + 1] ; ++transfer) {
+                    label_t label;
+                    label.arrival = labels[from].arrival + timetable.transfer_durations[transfer];
+                    label.from = from;
+                    label.trip_or_footpath = transfer;
+                    improve(labels, timetable.transfer_targets[transfer], label);
+                }
+            }
+        };
+
+        auto earliest_trip = [&](uint32_t pattern, uint32_t position, ds::seconds_t time,
+                uint32_t& trip, int32_t& day) {
+            auto const count = timetable.pattern_trip_count(pattern);
+            auto const column = timetable.pattern_departures.cbegin() + timetable.pattern_time(pattern, position, 0);
+            auto const trips = timetable.pattern_trips.cbegin() + timetable.pattern_trips_begin[pattern];
+            auto earliest = INFINITE_TIME;
+            auto const today = ds::day_offset(time);
+            for (auto d = today - max_day_span ; d <= today + 1 ; ++d) {
+                for (auto rank = static_cast<uint32_t>(std::lower_bound(column, column + count,
+                        time - d * ds::DAY_SECONDS) - column) ; rank < count ; ++rank) {
+                    auto const candidate = d * ds::DAY_SECONDS + column[rank];
+                    if (candidate >= earliest) {
+                        break;
+                    }
+                    if (timetable.is_service_active(timetable.trip_services[trips[rank]], query_day_number + d)) {
+                        earliest = candidate;
+                        trip = rank;
+                        day = d;
+                        break;
+                    }
+                }
+            }
+            return earliest;
+        };
+
+        label_t origin;
+        origin.arrival = departure;
+        auto& first_round = context.add_round();
+        improve(first_round, source, origin);
+        relax_footpaths(first_round);
+
+        while (!marked.empty() && context.round_count <= max_trips) {
+            for (auto stop : marked) {
+                previous.set(stop) = best[stop];
+                for (auto i = timetable.stop_patterns_begin[stop] ; i < timetable.stop_patterns_begin[stop + 1] ; ++i) {
+                    auto& from = pattern_from[timetable.stop_patterns[i]];
+                    if (from == ds::NO_INDEX) {
+                        queued_patterns.push_back(timetable.stop_patterns[i]);
+                    }
+                    from = std::min(from, timetable.stop_pattern_positions[i]);
+                }
+            }
+            marked.clear();
+            auto& labels = context.add_round();
+
+            for (auto p : queued_patterns) {
+                auto const stops = timetable.pattern_stops.cbegin() + timetable.pattern_stops_begin[p];
+                auto const width = timetable.pattern_width(p);
+                auto trip = ds::NO_INDEX;
+                int32_t day = 0;
+                uint32_t boarded_at = ds::NO_INDEX;
+                for (auto i = pattern_from[p] ; i < width ; ++i) {
+                    auto const stop = stops[i];
+                    if (trip != ds::NO_INDEX) {
+                        label_t label;
+                        label.arrival = day * ds::DAY_SECONDS
+                                + timetable.pattern_arrivals[timetable.pattern_time(p, i, trip)];
+                        label.from = boarded_at;
+                        label.pattern = p;
+                        label.trip_or_footpath = trip;
+                        label.position = static_cast<uint16_t>(i);
+                        label.day = static_cast<int16_t>(day);
+                        improve(labels, stop, label);
+                    }
+                    if (previous[stop] == INFINITE_TIME) {
+                        continue;
+                    }
+                    auto const departure = trip == ds::NO_INDEX ? INFINITE_TIME
+                            : day * ds::DAY_SECONDS + timetable.pattern_departures[timetable.pattern_time(p, i, trip)];
+                    if (previous[stop] > departure) {
+                        continue;
+                    }
+                    auto earlier_trip = ds::NO_INDEX;
+                    int32_t earlier_day = 0;
+                    auto const boarding = earliest_trip(p, i, previous[stop], earlier_trip, earlier_day);
+                    if (boarding < departure) {
+                        trip = earlier_trip;
+                        day = earlier_day;
+                        boarded_at = stop;
+                    }
+                }
+                pattern_from[p] = ds::NO_INDEX;
+            }
+            queued_patterns.clear();
+            relax_footpaths(labels);
+        }
+    }
+
+    ds::path_leg_t raptor_t::make_leg(ds::timetable_t const& timetable, ds::date_t const& query_day, uint32_t stop,
+            label_t const& label) const {
+        ds::path_leg_t leg;
+        leg.arrival = ds::to_date_time(query_day, label.arrival);
+        leg.stop = stop;
+        if (label.from != ds::NO_INDEX && label.pattern != ds::NO_INDEX) {
+            auto const trip = timetable.pattern_trips[timetable.pattern_trips_begin[label.pattern]
+                    + label.trip_or_footpath];
+            leg.transport = timetable.trip_stop_times_begin[trip] + label.position;
+        } else if (label.from != ds::NO_INDEX) {
+            leg.transfer = label.trip_or_footpath;
+        }
+        return leg;
+    }
+
+    std::vector<ds::path_leg_t> raptor_t::journey(ds::timetable_t const& timetable, uint32_t source,
+            uint32_t target, ds::date_time_t const& departure, query_context_t::raptor_state_t& context) const {
+        auto const query_day = departure.date();
+        context.reset(timetable, timetable.pattern_count());
+        route(timetable, source, target, static_cast<int32_t>(query_day.day_number()),
+                ds::seconds_since(query_day, departure), context);
+        auto const& best = context.best;
+        if (best[target] == INFINITE_TIME) {
+            throw std::runtime_error("Unable to find connection");
+        }
+        auto round = context.round_count - 1;
+        while (context.rounds[round][target].arrival != best[target]) {
+            --round;
+        }
+        return unwind(timetable, query_day, target, round, context);
+    }
+
+    std::vector<ds::path_leg_t> raptor_t::unwind(ds::timetable_t const& timetable, ds::date_t const& query_day,
+            uint32_t target, size_t round, query_context_t::raptor_state_t const& context) const {
+        auto const& rounds = context.rounds;
+        std::vector<ds::path_leg_t> legs;
+        auto stop = target;
+        while (true) {
+            while (rounds[round][stop].arrival == INFINITE_TIME) {
+                --round;
+            }
+            auto const& label = rounds[round][stop];
+            legs.push_back(make_leg(timetable, query_day, stop, label));
+            if (label.from == ds::NO_INDEX) {
+                break;
+            }
+            if (label.pattern != ds::NO_INDEX) {
+                --round;
+            }
+            stop = label.from;
+        }
+        std::reverse(legs.begin(), legs.end());
+        return legs;
+    }
+
+    // the round of a label is the number of trips it took, and a round only keeps labels that arrive earlier
+    // than all rounds before it. So every round that reached the target adds a journey to the front, except
+    // walking all the way when a single trip, with no transfer either, arrives earlier
+    std::vector<std::vector<ds::path_leg_t>> raptor_t::pareto(ds::timetable_t const& timetable, uint32_t source,
+            uint32_t target, ds::date_time_t const& departure, uint32_t max_transfers,
+            query_context_t::raptor_state_t& context) const {
+        auto const query_day = departure.date();
+        context.reset(timetable, timetable.pattern_count());
+        route(timetable, source, target, static_cast<int32_t>(query_day.day_number()),
+                ds::seconds_since(query_day, departure), context,
+                max_transfers == NO_LIMIT ? NO_LIMIT : max_transfers + 1);
+        std::vector<std::vector<ds::path_leg_t>> journeys;
+        auto const& rounds = context.rounds;
+        for (size_t round = 0 ; round < context.round_count ; ++round) {
+            if (round == 0 && context.round_count > 1 && rounds[1][target].arrival != INFINITE_TIME) {
+                continue;
+            }
+            if (rounds[round][target].arrival != INFINITE_TIME) {
+                journeys.push_back(unwind(timetable, query_day, target, round, context));
+            }
+        }
+        if (journeys.empty()) {
+            throw std::runtime_error("Unable to find connection");
+        }
+        return journeys;
+    }
+
+    std::vector<ds::date_time_t> raptor_t::earliest_arrivals(ds::timetable_t const& timetable, uint32_t source,
+            ds::date_time_t const& departure, query_context_t::raptor_state_t& context) const {
+        auto const query_day = departure.date();
+        context.reset(timetable, timetable.pattern_count());
+        route(timetable, source, ds::NO_INDEX, static_cast<int32_t>(query_day.day_number()),
+                ds::seconds_since(query_day, departure), context);
+        std::vector<ds::date_time_t> arrivals(timetable.stop_count(), boost::posix_time::not_a_date_time);
+        for (uint32_t stop = 0 ; stop < arrivals.size() ; ++stop) {
+            if (context.best[stop] != INFINITE_TIME) {
+                arrivals[stop] = ds::to_date_time(query_day, context.best[stop]);
+            }
+        }
+        return arrivals;
+    }
+
+    // rRAPTOR: one run per departure from the source, latest first. Runs share best arrivals, anything reached
+    // by a later departure is reachable from an earlier one as well, so a run only explores what it improves
+    // and a departure is kept when it arrives earlier than every later one
+    std::vector<std::vector<ds::path_leg_t>> raptor_t::profile(ds::timetable_t const& timetable, uint32_t source,
+            uint32_t target, ds::date_time_t const& window_begin, ds::date_time_t const& window_end,
+            query_context_t::raptor_state_t& context) const {
+        auto const query_day = window_begin.date();
+        auto const query_day_number = static_cast<int32_t>(query_day.day_number());
+        auto const begin = ds::seconds_since(query_day, window_begin);
+        auto const end = ds::seconds_since(query_day, window_end);
+
+        // shortest walks from the source over transfers, the runs walk as far. Their times are kept in best
+        // until the runs start
+        context.reset(timetable, timetable.pattern_count());
+        auto& walk = context.best;
+        std::vector<std::pair<ds::seconds_t, uint32_t>> queue(1, std::make_pair(0, source));
+        std::vector<std::pair<uint32_t, ds::seconds_t>> walks;
+        walk.set(source) = 0;
+        while (!queue.empty()) {
+            std::pop_heap(queue.begin(), queue.end(), std::greater<>());
+            auto const next = queue.back();
+            queue.pop_back();
+            if (next.first > walk[next.second]) {
+                continue;
+            }
+            walks.emplace_back(next.second, next.first);
+            for (auto transfer = timetable.stop_transfers_begin[next.second] ;
+                    transfer < timetable.stop_transfers_begin[next.second + 1] ; ++transfer) {
+                auto const to = timetable.transfer_targets[transfer];
+                auto const time = next.first + timetable.transfer_durations[transfer];
+                if (time < walk[to]) {
+                    walk.set(to) = time;
+                    queue.emplace_back(time, to);
+                    std::push_heap(queue.begin(), queue.end(), std::greater<>());
+                }
+            }
+        }
+
+        // boarding after a walk departs from the source that much earlier
+        std::vector<ds::seconds_t> departures;
+        auto add_departures = [&](uint32_t stop, ds::seconds_t walk) {
+            auto const first = timetable.departures.cbegin() + timetable.stop_departures_begin[stop];
+            auto const last = timetable.departures.cbegin() + timetable.stop_departures_begin[stop + 1];
+            for (auto d = ds::day_offset(begin + walk) - max_day_span ; d <= ds::day_offset(end + walk) ; ++d) {
+                auto const local_begin = begin + walk - d * ds::DAY_SECONDS;
+                auto const local_end = end + walk - d * ds::DAY_SECONDS;
+                for (auto it = std::lower_bound(first, last, local_begin, [&](uint32_t l, ds::seconds_t r) {
+                        return timetable.stop_time_departures[l] < r;
+                    }) ; it != last && timetable.stop_time_departures[*it] <= local_end ; ++it) {
+                    auto const trip = timetable.stop_time_trips[*it];
+                    if (*it + 1 == timetable.trip_stop_times_begin[trip + 1]
+                            || !timetable.is_service_active(timetable.trip_services[trip], query_day_number + d)) {
+                        continue;
+                    }
+                    departures.push_back(d * ds::DAY_SECONDS + timetable.stop_time_departures[*it] - walk);
+                }
+            }
+        };
+        for (auto const& walk : walks) {
+            add_departures(walk.first, walk.second);
+        }
+        std::sort(departures.begin(), departures.end(), std::greater<>());
+        departures.erase(std::unique(departures.begin(), departures.end()), departures.end());
+
+        std::vector<std::vector<ds::path_leg_t>> journeys;
+        context.reset(timetable, timetable.pattern_count());
+        auto arrival = INFINITE_TIME;
+        for (auto departure : departures) {
+            context.start_run();
+            route(timetable, source, target, query_day_number, departure, context);
+            if (context.best[target] >= arrival) {
+                continue;
+            }
+            arrival = context.best[target];
+            std::vector<ds::path_leg_t> legs;
+            for (auto stop = target ; stop != ds::NO_INDEX ; stop = context.latest[stop].from) {
+                legs.push_back(make_leg(timetable, query_day, stop, context.latest[stop]));
+            }
+            std::reverse(legs.begin(), legs.end());
+            journeys.push_back(std::move(legs));
+        }
+        std::reverse(journeys.begin(), journeys.end());
+        return journeys;
+    }
+}
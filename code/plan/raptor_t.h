@@ -0,0 +1,76 @@
+#ifndef PLANNER_RAPTOR_T_H
+#define PLANNER_RAPTOR_T_H
+
+#include "query_context_t.h"
+#include "timetable_t.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace processing {
+
+    constexpr uint32_t NO_LIMIT = std::numeric_limits<uint32_t>::max();
+
+    // Round-based router (RAPTOR). Every round relaxes whole route patterns of the timetable instead of single
+    // stop times, the earliest trip of a pattern from a stop is a binary search on its column of departures.
+    // Round k finds the earliest arrivals using at most k vehicles.
+    class raptor_t {
+        using label_t = raptor_label_t;
+
+        int32_t max_day_span;
+
+        // runs the rounds of one departure on a context reset before, target may be NO_INDEX to reach every
+        // stop. Times are seconds since midnight of the query day, results stay in the context
+        void route(data_structures::timetable_t const& timetable, uint32_t source, uint32_t target,
+                int32_t query_day_number, data_structures::seconds_t departure,
+                query_context_t::raptor_state_t& context, uint32_t max_trips = NO_LIMIT) const;
+
+        // path to the label of target in round, or the closest round before it
+        std::vector<data_structures::path_leg_t> unwind(data_structures::timetable_t const& timetable,
+                data_structures::date_t const& query_day, uint32_t target, size_t round,
+                query_context_t::raptor_state_t const& context) const;
+
+        data_structures::path_leg_t make_leg(data_structures::timetable_t const& timetable,
+                data_structures::date_t const& query_day, uint32_t stop, label_t const& label) const;
+    public:
+        explicit raptor_t(data_structures::timetable_t const& timetable);
+
+        std::vector<data_structures::path_leg_t> journey(
+                data_structures::timetable_t const& timetable,
+                uint32_t source,
+                uint32_t target,
+                data_structures::date_time_t const& departure,
+                query_context_t::raptor_state_t& context) const;
+
+        // Pareto front of arrival and transfers: by the number of transfers, each journey arriving earlier than
+        // the ones with fewer transfers. Rounds past max_transfers + 1 trips are not run
+        std::vector<std::vector<data_structures::path_leg_t>> pareto(
+                data_structures::timetable_t const& timetable,
+                uint32_t source,
+                uint32_t target,
+                data_structures::date_time_t const& departure,
+                uint32_t max_transfers,
+                query_context_t::raptor_state_t& context) const;
+
+        // earliest arrival at every stop, not_a_date_time for stops that can not be reached
+        std::vector<data_structures::date_time_t> earliest_arrivals(
+                data_structures::timetable_t const& timetable,
+                uint32_t source,
+                data_structures::date_time_t const& departure,
+                query_context_t::raptor_state_t& context) const;
+
+        // Pareto optimal journeys departing within the window in order of departure, each one arrives later
+        // than the one before it or it would not be optimal. The first leg of a journey gives its departure
+        std::vector<std::vector<data_structures::path_leg_t>> profile(
+                data_structures::timetable_t const& timetable,
+                uint32_t source,
+                uint32_t target,
+                data_structures::date_time_t const& window_begin,
+                data_structures::date_time_t const& window_end,
+                query_context_t::raptor_state_t& context) const;
+    };
+
+}
+
+#endif //PLANNER_RAPTOR_T_H
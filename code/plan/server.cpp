@@ -0,0 +1,372 @@
+#include "server.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace ds = data_structures;
+
+namespace {
+    std::runtime_error system_error(std::string const& message, std::string const& path) {
+        return std::runtime_error(message + " " + path + ": " + std::strerror(errno));
+    }
+
+    // removes the socket at path, a missing one is fine but anything else there is not ours to remove
+    void remove_socket(std::string const& path) {
+        struct stat status{};
+        if (::lstat(path.c_str(), &status) == -1) {
+            if (errno == ENOENT) {
+                return;
+            }
+            throw system_error("Unable to stat", path);
+        }
+        if (!S_ISSOCK(status.st_mode)) {
+            throw std::runtime_error("Not a socket, refusing to remove " + path);
+        }
+        if (::unlink(path.c_str()) == -1 && errno != ENOENT) {
+            throw system_error("Unable to remove", path);
+        }
+    }
+
+    // line oriented reading and writing on a connected socket. Reading never blocks, the lines are taken once they
+    // all arrived
+    class connection_t {
+        int socket;
+        std::string received;
+        size_t begin = 0;
+        bool closed = false;
+
+        static constexpr size_t BUFFER_SIZE = 4096;
+        static constexpr time_t WRITE_TIMEOUT = 10; // seconds a client may take to read an answer
+    public:
+        explicit connection_t(int socket) : socket(socket) {
+            timeval const timeout{WRITE_TIMEOUT, 0};
+            ::setsockopt(socket, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        }
+
+        connection_t(connection_t const&) = delete;
+        connection_t& operator=(connection_t const&) = delete;
+
+        ~connection_t() {
+            ::close(socket);
+        }
+
+        int descriptor() const {
+            return socket;
+        }
+
+        // appends what arrived so far, until the peer closes the connection
+        void receive() {
+            char buffer[BUFFER_SIZE];
+            while (!closed) {
+                auto const count = ::recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                }
+                if (count <= 0) {
+                    closed = true;
+                    return;
+                }
+                received.append(buffer, static_cast<size_t>(count));
+            }
+        }
+
+        // true when a query, a 'q' or the end of the connection is ready to be served
+        bool has_query() const {
+            auto const first = received.find('\n', begin);
+            if (closed || (first != std::string::npos && (received.compare(begin, first - begin, "q") == 0
+                    || received.compare(begin, first - begin, "q\r") == 0))) {
+                return true;
+            }
+            auto const lines = std::count(received.begin() + begin, received.end(), '\n');
+            return lines >= 3;
+        }
+
+        // false once no line is left, a last line without line break is still returned when the peer closed
+        bool read_line(std::string& line) {
+            auto const found = received.find('\n', begin);
+            if (found == std::string::npos && (!closed || begin == received.size())) {
+                return false;
+            }
+            auto const line_end = found == std::string::npos ? received.size() : found;
+            line.assign(received, begin, line_end - begin);
+            begin = found == std::string::npos ? line_end : line_end + 1;
+            if (!line.empty() && line.back() == '\r') {
+                line.pop_back();
+            }
+            if (begin == received.size()) {
+                received.clear();
+                begin = 0;
+            }
+            return true;
+        }
+
+        bool write(std::string const& text) {
+            for (size_t sent = 0 ; sent < text.size() ; ) {
+                auto const count = ::send(socket, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+                if (count < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (count <= 0) {
+                    return false;
+                }
+                sent += static_cast<size_t>(count);
+            }
+            return true;
+        }
+    };
+
+    constexpr size_t connection_t::BUFFER_SIZE;
+    constexpr time_t connection_t::WRITE_TIMEOUT;
+
+    void write_legs(ds::timetable_t const& timetable, std::vector<ds::path_leg_t> const& legs, std::ostream& out) {
+        for (auto const& leg : legs) {
+            out << "Next stop: " << timetable.stop_names[leg.stop] << std::endl;
+            out << "\tDate and time: " << leg.arrival << std::endl;
+            if (leg.transport != ds::NO_INDEX) {
+                auto const trip = timetable.stop_time_trips[leg.transport];
+                auto const route = timetable.trip_routes[trip];
+                out << "\tArrived by " << timetable.route_descs[route]
+                    << " " << timetable.route_short_names[route]
+                    << " direction to " << timetable.trip_head_signs[trip] << std::endl;
+            }
+            if (leg.transfer != ds::NO_INDEX) {
+                out << "\tArrived by foot. Transfer time: "
+                    << boost::posix_time::seconds(timetable.transfer_durations[leg.transfer]) << std::endl;
+            }
+        }
+    }
+
+    // answers the next query of the connection, false when the connection is done with
+    bool serve_query(processing::map_graph_t const& map, processing::query_context_t& context,
+            connection_t& connection, util::query_options_t const& options) {
+        std::string start, finish, departure;
+        if (!connection.read_line(start) || start == "q") {
+            return false;
+        }
+        if (!connection.read_line(finish) || !connection.read_line(departure)) {
+            return false;
+        }
+        std::ostringstream answer;
+        util::answer_query(map, context, start, finish, departure, options, answer);
+        answer << '\n';
+        return connection.write(answer.str());
+    }
+
+    // The connections are polled on one thread and every query whose lines all arrived goes to the next free
+    // worker, so an idle client holds no worker. A served connection goes back to the poll through a pipe that
+    // wakes it
+    class server_t {
+        processing::map_graph_t const& map;
+        util::query_options_t const& options;
+        int listener;
+        int wake[2];
+
+        std::mutex mutex;
+        std::condition_variable queued;
+        std::deque<std::unique_ptr<connection_t>> ready; // a query to serve
+        std::vector<std::unique_ptr<connection_t>> served; // back to the poll
+        bool stopping = false;
+
+        void worker() {
+            processing::query_context_t context;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                queued.wait(lock, [this] { return stopping || !ready.empty(); });
+                if (stopping) {
+                    return;
+                }
+                auto connection = std::move(ready.front());
+                ready.pop_front();
+                lock.unlock();
+                if (!serve_query(map, context, *connection, options)) {
+                    connection.reset();
+                    lock.lock();
+                    continue;
+                }
+                lock.lock();
+                if (connection->has_query()) {
+                    // behind the queries already waiting, a busy client does not hold a worker either
+                    ready.push_back(std::move(connection));
+                    queued.notify_one();
+                } else {
+                    served.push_back(std::move(connection));
+                    char const byte = 0;
+                    // a full pipe wakes the poll already
+                    while (::write(wake[1], &byte, 1) == -1 && errno == EINTR) {
+                    }
+                }
+            }
+        }
+
+        void dispatch(std::unique_ptr<connection_t> connection) {
+            std::lock_guard<std::mutex> lock(mutex);
+            ready.push_back(std::move(connection));
+            queued.notify_one();
+        }
+
+        // accepts and polls until accepting fails
+        void poll_connections() {
+            std::vector<std::unique_ptr<connection_t>> idle;
+            std::vector<pollfd> descriptors;
+            while (true) {
+                descriptors.assign({{listener, POLLIN, 0}, {wake[0], POLLIN, 0}});
+                for (auto const& connection : idle) {
+                    descriptors.push_back({connection->descriptor(), POLLIN, 0});
+                }
+                if (::poll(descriptors.data(), descriptors.size(), -1) == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    std::cerr << "Unable to poll connections: " << std::strerror(errno) << std::endl;
+                    return;
+                }
+                // the descriptors after the first two are the idle connections before any change below
+                for (size_t i = descriptors.size() ; i-- > 2 ; ) {
+                    if (descriptors[i].revents == 0) {
+                        continue;
+                    }
+                    auto& connection = idle[i - 2];
+                    connection->receive();
+                    if (connection->has_query()) {
+                        dispatch(std::move(connection));
+                        idle.erase(idle.begin() + static_cast<std::ptrdiff_t>(i - 2));
+                    }
+                }
+                if (descriptors[1].revents != 0) {
+                    char bytes[64];
+                    while (::read(wake[0], bytes, sizeof(bytes)) > 0) {
+                    }
+                    std::lock_guard<std::mutex> lock(mutex);
+                    for (auto& connection : served) {
+                        idle.push_back(std::move(connection));
+                    }
+                    served.clear();
+                }
+                if (descriptors[0].revents != 0) {
+                    auto const socket = ::accept(listener, nullptr, nullptr);
+                    if (socket != -1) {
+                        idle.emplace_back(new connection_t(socket));
+                    } else if (errno != EINTR && errno != ECONNABORTED && errno != EAGAIN && errno != EWOULDBLOCK) {
+                        std::cerr << "Unable to accept connection: " << std::strerror(errno) << std::endl;
+                        return;
+                    }
+                }
+            }
+        }
+    public:
+        server_t(processing::map_graph_t const& map, util::query_options_t const& options, int listener)
+                : map(map), options(options), listener(listener) {
+            if (::pipe(wake) == -1) {
+                throw std::runtime_error(std::string("Unable to create pipe: ") + std::strerror(errno));
+            }
+            for (auto descriptor : {listener, wake[0], wake[1]}) {
+                ::fcntl(descriptor, F_SETFL, ::fcntl(descriptor, F_GETFL) | O_NONBLOCK);
+            }
+        }
+
+        server_t(server_t const&) = delete;
+        server_t& operator=(server_t const&) = delete;
+
+        ~server_t() {
+            ::close(wake[0]);
+            ::close(wake[1]);
+        }
+
+        void run(unsigned threads) {
+            std::vector<std::thread> workers;
+            for (unsigned i = 0 ; i < threads ; ++i) {
+                workers.emplace_back(&server_t::worker, this);
+            }
+            poll_connections();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            queued.notify_all();
+            for (auto& thread : workers) {
+                thread.join();
+            }
+        }
+    };
+}
+
+namespace util {
+    void answer_query(processing::map_graph_t const& map, processing::query_context_t& context,
+            std::string const& start, std::string const& finish, std::string const& departure,
+            query_options_t const& options, std::ostream& out) {
+        try {
+            auto const departure_time = boost::posix_time::time_from_string(departure);
+            if (!options.pareto) {
+                write_legs(map.get_timetable(),
+                        map.journey(start, finish, departure_time, context, options.engine), out);
+            } else {
+                auto const journeys = map.pareto_journeys(start, finish, departure_time, context,
+                        options.max_transfers);
+                for (auto const& legs : journeys) {
+                    auto const trips = processing::count_trips(map.get_timetable(), legs);
+                    out << "Option with " << (trips == 0 ? 0 : trips - 1) << " transfers" << std::endl;
+                    write_legs(map.get_timetable(), legs, out);
+                }
+            }
+        } catch (std::exception const& e) {
+            out << "Something wrong: " << e.what() << std::endl;
+        }
+        // failed queries too, they are often the slow ones
+        if (options.stats) {
+            out << "Stats: " << context.stats << std::endl;
+        }
+    }
+
+    void serve(processing::map_graph_t const& map, std::string const& socket_path, unsigned threads,
+            query_options_t const& options) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socket_path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Socket path is too long: " + socket_path);
+        }
+        std::strcpy(address.sun_path, socket_path.c_str());
+        // a socket left behind by a previous run would make bind fail
+        remove_socket(socket_path);
+        auto const listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener == -1) {
+            throw system_error("Unable to create socket", socket_path);
+        }
+        if (::bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) == -1
+                || ::listen(listener, SOMAXCONN) == -1) {
+            auto const error = system_error("Unable to listen on", socket_path);
+            ::close(listener);
+            throw error;
+        }
+        std::cout << "Serving on " << socket_path << " with " << threads << " threads" << std::endl;
+
+        try {
+            server_t(map, options, listener).run(std::max(threads, 1u));
+        } catch (...) {
+            ::close(listener);
+            throw;
+        }
+        ::close(listener);
+        remove_socket(socket_path);
+    }
+}
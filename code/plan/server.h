@@ -0,0 +1,34 @@
+#ifndef PLANNER_SERVER_H
+#define PLANNER_SERVER_H
+
+#include "map_graph_t.h"
+
+#include <ostream>
+#include <string>
+
+namespace util {
+
+struct query_options_t {
+    processing::engine_t engine = processing::engine_t::dijkstra;
+    // every journey of the Pareto front of arrival and transfers instead of the earliest arrival only
+    bool pareto = false;
+    uint32_t max_transfers = processing::NO_LIMIT;
+    // the stats of every query after its answer
+    bool stats = false;
+};
+
+// routes one query and writes the legs, or what went wrong, in the text format of the interactive mode
+void answer_query(processing::map_graph_t const& map, processing::query_context_t& context, std::string const& start,
+        std::string const& finish, std::string const& departure, query_options_t const& options, std::ostream& out);
+
+// Serves queries on a unix domain socket with a pool of worker threads sharing the read only map. A client sends
+// start id, finish id and departure date time each on a separate line, like on the terminal, and gets the answer
+// ended by an empty line; 'q' closes the connection. The connections are polled and every query whose lines all
+// arrived goes to the next free worker with its own scratch memory, so concurrent clients are answered in parallel
+// and idle ones hold no worker. Throws when the socket can not be opened
+void serve(processing::map_graph_t const& map, std::string const& socket_path, unsigned threads,
+        query_options_t const& options);
+
+} // util
+
+#endif //PLANNER_SERVER_H
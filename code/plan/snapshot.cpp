@@ -0,0 +1,84 @@
+#include "snapshot.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+
+namespace ds = data_structures;
+
+namespace {
+    std::runtime_error system_error(std::string const& message, std::string const& path) {
+        return std::runtime_error(message + " " + path + ": " + std::strerror(errno));
+    }
+
+    class mapped_image_t : public ds::image_t {
+        void* address = MAP_FAILED;
+        size_t length = 0;
+    public:
+        explicit mapped_image_t(std::string const& path) {
+            auto const file = ::open(path.c_str(), O_RDONLY);
+            if (file == -1) {
+                throw system_error("Unable to open timetable", path);
+            }
+            struct stat status;
+            if (::fstat(file, &status) == -1) {
+                ::close(file);
+                throw system_error("Unable to stat timetable", path);
+            }
+            length = static_cast<size_t>(status.st_size);
+            if (length != 0) {
+                address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, file, 0);
+            }
+            ::close(file);
+            if (length != 0 && address == MAP_FAILED) {
+                throw system_error("Unable to map timetable", path);
+            }
+        }
+
+        mapped_image_t(mapped_image_t const&) = delete;
+        mapped_image_t& operator=(mapped_image_t const&) = delete;
+
+        ~mapped_image_t() override {
+            if (address != MAP_FAILED) {
+                ::munmap(address, length);
+            }
+        }
+
+        char const* data() const override {
+            return address == MAP_FAILED ? nullptr : static_cast<char const*>(address);
+        }
+
+        size_t size() const override {
+            return length;
+        }
+    };
+}
+
+namespace util {
+    void write_snapshot(ds::timetable_t const& timetable, std::string const& path) {
+        // written next to the target and renamed, so a running planner never maps a half written file
+        auto const temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            out.write(timetable.image->data(), timetable.image->size());
+            out.close();
+            if (!out) {
+                throw system_error("Unable to write timetable", temporary);
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            throw system_error("Unable to rename timetable to", path);
+        }
+    }
+
+    ds::timetable_t load_snapshot(std::string const& path) {
+        return ds::timetable_t(std::make_shared<mapped_image_t>(path));
+    }
+}
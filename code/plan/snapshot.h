@@ -0,0 +1,18 @@
+#ifndef PLANNER_SNAPSHOT_H
+#define PLANNER_SNAPSHOT_H
+
+#include "timetable_t.h"
+
+#include <string>
+
+namespace util {
+
+// writes the compiled timetable image as is, so it can be mapped back without any decoding
+void write_snapshot(data_structures::timetable_t const& timetable, std::string const& path);
+
+// maps the snapshot into memory read only, the timetable arrays point straight into the mapping
+data_structures::timetable_t load_snapshot(std::string const& path);
+
+} // util
+
+#endif //PLANNER_SNAPSHOT_H
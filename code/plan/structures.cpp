@@ -4,4 +4,16 @@ namespace data_structures {
     bool stop_time_cmp(stop_time_ptr const& l, stop_time_ptr const& r) {
         return l->departure < r->departure;
     }
+
+    int32_t day_offset(seconds_t time) {
+        return time >= 0 ? time / DAY_SECONDS : -((-time + DAY_SECONDS - 1) / DAY_SECONDS);
+    }
+
+    seconds_t seconds_since(date_t const& day, date_time_t const& date_time) {
+        return static_cast<seconds_t>((date_time - date_time_t(day)).total_seconds());
+    }
+
+    date_time_t to_date_time(date_t const& day, seconds_t time) {
+        return date_time_t(day, boost::posix_time::seconds(time));
+    }
 }
\ No newline at end of file
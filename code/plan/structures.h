@@ -1,16 +1,17 @@
 #ifndef PLANNER_STRUCTURES_H
 #define PLANNER_STRUCTURES_H
 
+#include "arena_t.h"
+#include "id_table_t.h"
+
 #include <boost/cstdint.hpp>
 #include <boost/date_time/gregorian/gregorian.hpp>
 #include <boost/date_time/gregorian/greg_weekday.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include <boost/geometry/geometries/geometries.hpp>
-#include <memory>
+#include <cstdint>
 #include <string>
 #include <vector>
-#include <unordered_map>
-#include <unordered_set>
 
 namespace data_structures {
     namespace bg = boost::geometry;
@@ -24,107 +25,147 @@ namespace data_structures {
     struct trip_t;
     struct stop_time_t;
 
-    template<typename T>
-    using value_by_id = std::unordered_map<std::string, T>;
+    constexpr int32_t DAY_SECONDS = 24 * 60 * 60;
 
     using week_day = boost::gregorian::greg_weekday::weekday_enum;
 
-    using route_ptr = std::shared_ptr<route_t>;
-    using agency_ptr = std::shared_ptr<agency_t>;
-    using service_ptr = std::shared_ptr<service_t>;
-    using service_exception_ptr = std::shared_ptr<service_exception_t>;
-    using stop_ptr = std::shared_ptr<stop_t>;
-    using transfer_ptr = std::shared_ptr<transfer_t>;
-    using trip_ptr = std::shared_ptr<trip_t>;
-    using stop_time_ptr = std::shared_ptr<stop_time_t>;
+    // entities are owned by the arenas of a feed_t and point at each other with plain pointers
+    using route_ptr = route_t*;
+    using agency_ptr = agency_t*;
+    using service_ptr = service_t*;
+    using service_exception_ptr = service_exception_t*;
+    using stop_ptr = stop_t*;
+    using transfer_ptr = transfer_t*;
+    using trip_ptr = trip_t*;
+    using stop_time_ptr = stop_time_t*;
 
     using date_t = boost::gregorian::date;
-    using time_t = boost::posix_time::time_duration;
     using date_time_t = boost::posix_time::ptime;
+    // seconds since midnight of the service day. Trips running over midnight have times past 24:00:00,
+    // times on other days are shifted by whole DAY_SECONDS
+    using seconds_t = int32_t;
     using point_t = bg::model::point<double, 2, bg::cs::geographic<bg::degree> >;
 
+    // children of one entity, stored next to each other in an array allocated from the feed arenas
+    template<typename T>
+    struct range_t {
+        T* first = nullptr;
+        uint32_t count = 0;
+
+        T* begin() const {
+            return first;
+        }
+
+        T* end() const {
+            return first + count;
+        }
+
+        uint32_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+    };
+
+    // ids are views of the interned ids owned by the value_by_id holding the entity, other text is copied
+    // into the arena of the entity type
     struct agency_t {
-        std::string id;
-        std::string name;
-        std::string url;
-        std::string timezone;
-        std::vector<route_ptr> routes;
+        boost::string_view id;
+        boost::string_view name;
+        boost::string_view url;
+        boost::string_view timezone;
     };
 
     struct route_t {
-        std::string id;
-        agency_ptr agency;
-        std::string short_name;
-        std::string long_name;
-        std::string desc;
+        boost::string_view id;
+        agency_ptr agency = nullptr;
+        boost::string_view short_name;
+        boost::string_view long_name;
+        boost::string_view desc;
         int type;
-        std::vector<trip_ptr> trips;
     };
 
     struct service_exception_t {
+        service_ptr service = nullptr;
         date_t date;
         int type; // 1 - added as subs, 2 - interrupted
     };
 
-    struct date_hasher_t {
-        size_t operator()(date_t const& date) const {
-            static boost::posix_time::ptime const epoch(boost::gregorian::date(1970, 1, 1));
-            boost::posix_time::ptime time(date);
-            return (time - epoch).total_milliseconds();
-        }
-    };
-
     struct service_t {
-       std::string id;
+       boost::string_view id;
        date_t start;
        date_t end;
-       std::unordered_set<week_day> week_days;
-       std::unordered_map<date_t, service_exception_ptr, date_hasher_t> exceptions;
-       std::vector<trip_ptr> trips;
+       uint8_t week_days = 0; // bit per boost week day, sunday is bit 0
+       range_t<service_exception_ptr> exceptions; // ordered by date, one per date
     };
 
     struct stop_t {
-        std::string id;
-        std::string name;
+        boost::string_view id;
+        boost::string_view name;
         point_t location;
-        stop_ptr parent;
-        std::vector<transfer_ptr> transfers;
-        std::vector<stop_time_ptr> stop_times;
+        stop_ptr parent = nullptr;
+        range_t<transfer_ptr> transfers;
     };
 
     struct transfer_t {
-        stop_ptr from;
-        stop_ptr to;
+        stop_ptr from = nullptr;
+        stop_ptr to = nullptr;
         int type;
-        time_t duration;
+        seconds_t duration;
     };
 
     struct trip_t {
-        route_ptr route;
-        service_ptr service;
-        std::string id;
-        std::string head_sign;
-        std::string short_name;
+        route_ptr route = nullptr;
+        service_ptr service = nullptr;
+        boost::string_view id;
+        boost::string_view head_sign;
+        boost::string_view short_name;
         int direction;
-        std::vector<stop_time_ptr> stop_times;
+        range_t<stop_time_ptr> stop_times; // sorted by sequence
     };
 
     struct stop_time_t {
-        stop_ptr stop;
-        trip_ptr trip;
+        stop_ptr stop = nullptr;
+        trip_ptr trip = nullptr;
         int sequence;
-        time_t arrival;
-        time_t departure;
+        seconds_t arrival;
+        seconds_t departure;
+    };
+
+    // Everything parsed from a feed. Entities, their text and their child arrays live in one arena per entity
+    // type and ids in the id tables, so a feed is released by freeing blocks without visiting a single entity.
+    // stop times have one arena per part of stop_times.txt parsed in parallel
+    struct feed_t {
+        arena_t agency_arena;
+        arena_t route_arena;
+        arena_t service_arena;
+        arena_t service_exception_arena;
+        arena_t stop_arena;
+        arena_t transfer_arena;
+        arena_t trip_arena;
+        std::vector<arena_t> stop_time_arenas;
+
+        value_by_id<agency_ptr> agencies;
+        value_by_id<route_ptr> routes;
+        value_by_id<service_ptr> services;
+        value_by_id<stop_ptr> stops;
+        value_by_id<trip_ptr> trips;
+        size_t service_exception_count = 0;
+        size_t transfer_count = 0;
+        size_t stop_time_count = 0;
     };
 
     bool stop_time_cmp(stop_time_ptr const& l, stop_time_ptr const& r);
 
-    struct path_leg_t {
-        date_time_t  arrival;
-        stop_ptr stop;
-        stop_time_ptr transport;
-        transfer_ptr transfer; // transfer or transport is set. not both at the same time
-    };
+    // whole days in time, rounded towards minus infinity
+    int32_t day_offset(seconds_t time);
+
+    // conversions from and to boost types, only needed at the api edge
+    seconds_t seconds_since(date_t const& day, date_time_t const& date_time);
+
+    date_time_t to_date_time(date_t const& day, seconds_t time);
 }
 
 #endif //PLANNER_STRUCTURES_H
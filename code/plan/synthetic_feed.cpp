@@ -0,0 +1,229 @@
+#include "synthetic_feed.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <random>
+#include <vector>
+
+namespace fs = boost::filesystem;
+
+namespace {
+    constexpr double LATITUDE = 46.948;
+    constexpr double LONGITUDE = 7.447;
+    constexpr double METERS_PER_DEGREE = 111195;
+    constexpr double STOP_SPACING = 400; // meters, the area grows with the stops
+    constexpr double BUS_SPEED = 9; // meters per second between stops
+    constexpr double WALKING_SPEED = 1.2;
+    constexpr uint32_t DWELL = 20;
+    constexpr uint32_t MIN_HOP = 30;
+    constexpr uint32_t MIN_TRANSFER = 60;
+    constexpr uint32_t MAX_ROUTE_STOPS = 30;
+    constexpr uint32_t NEIGHBOURS = 8; // stops a route may go on to
+    constexpr uint32_t FIRST_DEPARTURE = 5 * 60 * 60;
+    constexpr uint32_t SERVICE_HOURS = 20 * 60 * 60; // the last trips run past midnight
+
+    struct point_t {
+        double x;
+        double y;
+    };
+
+    double distance(point_t const& l, point_t const& r) {
+        return std::hypot(l.x - r.x, l.y - r.y);
+    }
+
+    std::ofstream open_table(fs::path const& directory, char const* name) {
+        auto const path = (directory / name).string();
+        std::ofstream out(path, std::ios::trunc);
+        if (!out) {
+            throw std::runtime_error("Unable to write table: " + path);
+        }
+        return out;
+    }
+
+    void close_table(std::ofstream& out, fs::path const& directory, char const* name) {
+        out.close();
+        if (!out) {
+            throw std::runtime_error("Unable to write table: " + (directory / name).string());
+        }
+    }
+
+    std::string service_time(uint32_t time) {
+        char text[16];
+        std::snprintf(text, sizeof(text), "%02u:%02u:%02u", time / 3600, time / 60 % 60, time % 60);
+        return text;
+    }
+
+    // the count nearest stops of every stop, nearest first. Quadratic, fine for the sizes benchmarks use
+    std::vector<std::vector<uint32_t>> nearest_stops(std::vector<point_t> const& stops, uint32_t count) {
+        std::vector<std::vector<uint32_t>> result(stops.size());
+        std::vector<uint32_t> others;
+        for (uint32_t stop = 0 ; stop < stops.size() ; ++stop) {
+            others.clear();
+            for (uint32_t other = 0 ; other < stops.size() ; ++other) {
+                if (other != stop) {
+                    others.push_back(other);
+                }
+            }
+            auto const size = std::min<size_t>(count, others.size());
+            std::partial_sort(others.begin(), others.begin() + size, others.end(), [&](uint32_t l, uint32_t r) {
+                return distance(stops[stop], stops[l]) < distance(stops[stop], stops[r]);
+            });
+            result[stop].assign(others.begin(), others.begin() + size);
+        }
+        return result;
+    }
+
+    // from a random stop towards another one through neighbouring stops, at least two stops
+    std::vector<uint32_t> make_route(std::vector<point_t> const& stops,
+            std::vector<std::vector<uint32_t>> const& neighbours, std::mt19937& random) {
+        std::uniform_int_distribution<uint32_t> any_stop(0, static_cast<uint32_t>(stops.size() - 1));
+        std::vector<uint32_t> route;
+        while (route.size() < 2) {
+            route = {any_stop(random)};
+            auto const end = any_stop(random);
+            while (route.back() != end && route.size() < MAX_ROUTE_STOPS) {
+                auto next = ~0u;
+                for (auto neighbour : neighbours[route.back()]) {
+                    if (std::find(route.begin(), route.end(), neighbour) == route.end()
+                            && (next == ~0u || distance(stops[neighbour], stops[end])
+                                    < distance(stops[next], stops[end]))) {
+                        next = neighbour;
+                    }
+                }
+                if (next == ~0u) {
+                    break;
+                }
+                route.push_back(next);
+            }
+        }
+        return route;
+    }
+}
+
+namespace util {
+    void write_synthetic_feed(std::string const& directory_name, synthetic_feed_options_t const& options) {
+        if (options.stops < 2 || options.routes == 0) {
+            throw std::runtime_error("A synthetic feed needs two stops and a route");
+        }
+        fs::path const directory(directory_name);
+        fs::create_directories(directory);
+        std::mt19937 random(options.seed);
+
+        auto const side = STOP_SPACING * std::sqrt(static_cast<double>(options.stops));
+        std::uniform_real_distribution<double> coordinate(-side / 2, side / 2);
+        std::vector<point_t> stops(options.stops);
+        for (auto& stop : stops) {
+            stop.x = coordinate(random);
+            stop.y = coordinate(random);
+        }
+        auto const neighbours = nearest_stops(stops, NEIGHBOURS);
+
+        auto out = open_table(directory, "agency.txt");
+        out << "agency_id,agency_name,agency_url,agency_timezone\n";
+        out << "SYN,Synthetic Transit,http://example.com,Europe/Zurich\n";
+        close_table(out, directory, "agency.txt");
+
+        // most routes run daily, some on weekdays or weekends only, and a holiday swaps them
+        out = open_table(directory, "calendar.txt");
+        out << "service_id,monday,tuesday,wednesday,thursday,friday,saturday,sunday,start_date,end_date\n";
+        out << "DAILY,1,1,1,1,1,1,1,20190101,20191231\n";
+        out << "WEEKDAYS,1,1,1,1,1,0,0,20190101,20191231\n";
+        out << "WEEKENDS,0,0,0,0,0,1,1,20190101,20191231\n";
+        close_table(out, directory, "calendar.txt");
+        out = open_table(directory, "calendar_dates.txt");
+        out << "service_id,date,exception_type\n";
+        out << "WEEKDAYS,20190801,2\n";
+        out << "WEEKENDS,20190801,1\n";
+        close_table(out, directory, "calendar_dates.txt");
+
+        out = open_table(directory, "stops.txt");
+        out.precision(9);
+        out << "stop_id,stop_name,stop_lat,stop_lon,parent_station\n";
+        auto const meters_per_longitude = METERS_PER_DEGREE * std::cos(LATITUDE * 3.14159265358979323846 / 180);
+        for (uint32_t stop = 0 ; stop < stops.size() ; ++stop) {
+            out << 'S' << stop << ",Stop " << stop << ',' << LATITUDE + stops[stop].y / METERS_PER_DEGREE << ','
+                    << LONGITUDE + stops[stop].x / meters_per_longitude << ",\n";
+        }
+        close_table(out, directory, "stops.txt");
+
+        // footpaths join every two stops of a square cell holding one stop more than the density on average. Walks
+        // never leave a cell, so a walk of several footpaths is never faster than the direct one
+        out = open_table(directory, "transfers.txt");
+        out << "from_stop_id,to_stop_id,transfer_type,min_transfer_time\n";
+        if (options.transfers_per_stop > 0) {
+            auto const cell = STOP_SPACING * std::sqrt(options.transfers_per_stop + 1);
+            auto const cells_per_side = static_cast<uint32_t>(std::ceil(side / cell));
+            std::vector<std::vector<uint32_t>> cells(static_cast<size_t>(cells_per_side) * cells_per_side);
+            for (uint32_t stop = 0 ; stop < stops.size() ; ++stop) {
+                auto const column = static_cast<uint32_t>((stops[stop].x + side / 2) / cell);
+                auto const row = static_cast<uint32_t>((stops[stop].y + side / 2) / cell);
+                cells[static_cast<size_t>(std::min(row, cells_per_side - 1)) * cells_per_side
+                        + std::min(column, cells_per_side - 1)].push_back(stop);
+            }
+            for (auto const& members : cells) {
+                for (auto stop : members) {
+                    for (auto other : members) {
+                        if (other != stop) {
+                            out << 'S' << stop << ",S" << other << ",2," << MIN_TRANSFER
+                                    + static_cast<uint32_t>(distance(stops[stop], stops[other]) / WALKING_SPEED)
+                                    << '\n';
+                        }
+                    }
+                }
+            }
+        }
+        close_table(out, directory, "transfers.txt");
+
+        auto routes = open_table(directory, "routes.txt");
+        auto trips = open_table(directory, "trips.txt");
+        auto stop_times = open_table(directory, "stop_times.txt");
+        routes << "route_id,agency_id,route_short_name,route_long_name,route_desc,route_type\n";
+        trips << "route_id,service_id,trip_id,trip_headsign,trip_short_name,direction_id\n";
+        stop_times << "trip_id,arrival_time,departure_time,stop_id,stop_sequence\n";
+        std::uniform_real_distribution<double> chance(0, 1);
+        uint32_t trip = 0;
+        for (uint32_t route = 0 ; route < options.routes ; ++route) {
+            auto const route_stops = make_route(stops, neighbours, random);
+            auto const draw = chance(random);
+            auto const service = draw < 0.7 ? "DAILY" : draw < 0.9 ? "WEEKDAYS" : "WEEKENDS";
+            routes << 'R' << route << ",SYN," << route << ",Route " << route << ",Bus,3\n";
+            for (uint32_t direction = 0 ; direction < 2 ; ++direction) {
+                auto const part = route * 2 + direction;
+                auto const count = options.trips_per_day / (options.routes * 2)
+                        + (part < options.trips_per_day % (options.routes * 2) ? 1 : 0);
+                if (count == 0) {
+                    continue;
+                }
+                auto const headway = SERVICE_HOURS / count;
+                auto departure = FIRST_DEPARTURE + std::uniform_int_distribution<uint32_t>(0, headway)(random);
+                for (uint32_t i = 0 ; i < count ; ++i, ++trip, departure += headway) {
+                    auto const& last = direction == 0 ? route_stops.back() : route_stops.front();
+                    trips << 'R' << route << ',' << service << ",T" << trip << ",To S" << last << ",," << direction
+                            << '\n';
+                    auto time = departure;
+                    for (uint32_t sequence = 0 ; sequence < route_stops.size() ; ++sequence) {
+                        auto const stop = direction == 0 ? route_stops[sequence]
+                                : route_stops[route_stops.size() - 1 - sequence];
+                        if (sequence != 0) {
+                            auto const previous = direction == 0 ? route_stops[sequence - 1]
+                                    : route_stops[route_stops.size() - sequence];
+                            time += std::max(MIN_HOP,
+                                    static_cast<uint32_t>(distance(stops[previous], stops[stop]) / BUS_SPEED));
+                        }
+                        stop_times << 'T' << trip << ',' << service_time(time) << ',' << service_time(time + DWELL)
+                                << ",S" << stop << ',' << sequence + 1 << '\n';
+                        time += DWELL;
+                    }
+                }
+            }
+        }
+        close_table(routes, directory, "routes.txt");
+        close_table(trips, directory, "trips.txt");
+        close_table(stop_times, directory, "stop_times.txt");
+    }
+}
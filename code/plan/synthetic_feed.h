@@ -0,0 +1,24 @@
+#ifndef PLANNER_SYNTHETIC_FEED_H
+#define PLANNER_SYNTHETIC_FEED_H
+
+#include <cstdint>
+#include <string>
+
+namespace util {
+
+struct synthetic_feed_options_t {
+    uint32_t stops = 2000;
+    uint32_t routes = 100;
+    uint32_t trips_per_day = 5000; // over all routes and both directions
+    double transfers_per_stop = 4; // footpaths from a stop to the other stops of its cell, on average
+    uint32_t seed = 1;
+};
+
+// Writes a GTFS feed into directory, created when missing. Stops are scattered over a square around Bern,
+// routes run both ways through neighbouring stops at bus speed and footpaths take walking speed, so the feed
+// has a geography the A* bound can use. The same options always give the same feed
+void write_synthetic_feed(std::string const& directory, synthetic_feed_options_t const& options);
+
+} // util
+
+#endif //PLANNER_SYNTHETIC_FEED_H
@@ -0,0 +1,126 @@
+#include "task_graph_t.h"
+#include "memory_usage.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include <time.h>
+
+namespace {
+    std::chrono::nanoseconds thread_cpu_time() {
+        timespec time;
+        ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+        return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+    }
+}
+
+namespace util {
+
+    size_t task_graph_t::add(std::string name, std::function<void()> work,
+            std::initializer_list<size_t> dependencies) {
+        task_t task;
+        task.name = std::move(name);
+        task.work = std::move(work);
+        tasks.push_back(std::move(task));
+        auto const index = tasks.size() - 1;
+        for (auto dependency : dependencies) {
+            add_dependency(index, dependency);
+        }
+        return index;
+    }
+
+    void task_graph_t::add_dependency(size_t task, size_t dependency) {
+        tasks.at(dependency).dependents.push_back(task);
+        ++tasks.at(task).dependency_count;
+    }
+
+    std::vector<task_graph_t::task_t> const& task_graph_t::get_tasks() const {
+        return tasks;
+    }
+
+    void task_graph_t::run(unsigned threads) {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::vector<size_t> waiting_for(tasks.size());
+        std::vector<size_t> ready;
+        for (size_t i = 0 ; i < tasks.size() ; ++i) {
+            waiting_for[i] = tasks[i].dependency_count;
+            if (waiting_for[i] == 0) {
+                ready.push_back(i);
+            }
+        }
+        // tasks added first run first, so the caller decides what goes onto the critical path
+        std::reverse(ready.begin(), ready.end());
+        size_t finished = 0;
+        size_t running = 0;
+        std::exception_ptr failure;
+
+        auto worker = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                changed.wait(lock, [&]() {
+                    return !ready.empty() || failure || running == 0;
+                });
+                if (failure || ready.empty()) {
+                    return;
+                }
+                auto const current = ready.back();
+                ready.pop_back();
+                ++running;
+                lock.unlock();
+                auto const start = clock_t::now();
+                auto const cpu_start = thread_cpu_time();
+                auto const allocations_start = thread_allocations();
+                auto const resident_start = resident_bytes();
+                std::exception_ptr error;
+                try {
+                    tasks[current].work();
+                } catch (...) {
+                    error = std::current_exception();
+                }
+                auto const elapsed = clock_t::now() - start;
+                auto const cpu = thread_cpu_time() - cpu_start;
+                auto const allocations = thread_allocations() - allocations_start;
+                auto const resident_growth = static_cast<int64_t>(resident_bytes())
+                        - static_cast<int64_t>(resident_start);
+                lock.lock();
+                --running;
+                ++finished;
+                tasks[current].started = start;
+                tasks[current].elapsed = elapsed;
+                tasks[current].cpu = cpu;
+                tasks[current].allocations = allocations;
+                tasks[current].resident_growth = resident_growth;
+                if (error && !failure) {
+                    failure = error;
+                }
+                std::vector<size_t> released;
+                for (auto dependent : tasks[current].dependents) {
+                    if (--waiting_for[dependent] == 0) {
+                        released.push_back(dependent);
+                    }
+                }
+                ready.insert(ready.end(), released.rbegin(), released.rend());
+                changed.notify_all();
+            }
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 1 ; i < std::max(threads, 1u) ; ++i) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : pool) {
+            thread.join();
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+        if (finished != tasks.size()) {
+            throw std::runtime_error("Task graph has a dependency cycle");
+        }
+    }
+}
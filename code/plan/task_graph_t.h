@@ -0,0 +1,48 @@
+#ifndef PLANNER_TASK_GRAPH_T_H
+#define PLANNER_TASK_GRAPH_T_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+namespace util {
+
+    // Tasks with dependencies run on a fixed number of threads. A task starts as soon as everything it
+    // depends on has finished; the first exception stops scheduling and is rethrown by run.
+    class task_graph_t {
+    public:
+        using clock_t = std::chrono::steady_clock;
+
+        struct task_t {
+            std::string name;
+            std::function<void()> work;
+            std::vector<size_t> dependents;
+            size_t dependency_count = 0;
+            clock_t::time_point started{}; // tasks ran in the order they started
+            clock_t::duration elapsed = clock_t::duration::zero();
+            // cpu time of the running thread, unlike elapsed it does not grow when threads outnumber cores
+            std::chrono::nanoseconds cpu = std::chrono::nanoseconds::zero();
+            uint64_t allocations = 0;
+            // of the whole process while the task ran, so it includes what tasks running alongside took
+            int64_t resident_growth = 0;
+        };
+
+        size_t add(std::string name, std::function<void()> work, std::initializer_list<size_t> dependencies = {});
+
+        void add_dependency(size_t task, size_t dependency);
+
+        void run(unsigned threads);
+
+        std::vector<task_t> const& get_tasks() const;
+
+    private:
+        std::vector<task_t> tasks;
+    };
+
+}
+
+#endif //PLANNER_TASK_GRAPH_T_H
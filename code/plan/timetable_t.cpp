@@ -0,0 +1,410 @@
+#include "timetable_t.h"
+#include "trip_transfers.h"
+
+#include <boost/crc.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <type_traits>
+
+namespace ds = data_structures;
+
+namespace {
+    constexpr char IMAGE_MAGIC[8] = {'P', 'L', 'A', 'N', 'N', 'E', 'R', 'T'};
+    constexpr uint32_t IMAGE_BYTE_ORDER = 0x01020304;
+    constexpr uint64_t IMAGE_ALIGNMENT = 8;
+
+    struct image_header_t {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint32_t array_count;
+        uint32_t checksum; // crc32 of everything after the header
+        uint64_t size;
+    };
+
+    struct image_array_t {
+        uint64_t offset;
+        uint64_t count;
+        uint32_t element_size;
+        uint32_t reserved;
+    };
+
+    class memory_image_t : public ds::image_t {
+        std::vector<uint64_t> buffer;
+        size_t bytes;
+    public:
+        explicit memory_image_t(size_t bytes) : buffer((bytes + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0),
+                bytes(bytes) {
+        }
+
+        char* mutable_data() {
+            return reinterpret_cast<char*>(buffer.data());
+        }
+
+        char const* data() const override {
+            return reinterpret_cast<char const*>(buffer.data());
+        }
+
+        size_t size() const override {
+            return bytes;
+        }
+    };
+
+    uint64_t align(uint64_t offset) {
+        return (offset + IMAGE_ALIGNMENT - 1) / IMAGE_ALIGNMENT * IMAGE_ALIGNMENT;
+    }
+
+    uint32_t image_checksum(char const* data, size_t size) {
+        boost::crc_32_type crc;
+        crc.process_bytes(data + sizeof(image_header_t), size - sizeof(image_header_t));
+        return crc.checksum();
+    }
+
+    ds::image_ptr pack(ds::timetable_arrays_t<ds::vector_t> const& arrays) {
+        std::vector<image_array_t> table;
+        ds::timetable_arrays_t<ds::vector_t>::visit(arrays, [&](auto const& values) {
+            using value_t = typename std::decay_t<decltype(values)>::value_type;
+            table.push_back(image_array_t{0, values.size(), sizeof(value_t), 0});
+        });
+        auto offset = align(sizeof(image_header_t) + table.size() * sizeof(image_array_t));
+        for (auto& entry : table) {
+            entry.offset = offset;
+            offset = align(offset + entry.count * entry.element_size);
+        }
+
+        auto image = std::make_shared<memory_image_t>(offset);
+        auto const data = image->mutable_data();
+        std::memcpy(data + sizeof(image_header_t), table.data(), table.size() * sizeof(image_array_t));
+        size_t i = 0;
+        ds::timetable_arrays_t<ds::vector_t>::visit(arrays, [&](auto const& values) {
+            if (!values.empty()) {
+                std::memcpy(data + table[i].offset, values.data(), table[i].count * table[i].element_size);
+            }
+            ++i;
+        });
+
+        image_header_t header;
+        std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+        header.version = ds::TIMETABLE_VERSION;
+        header.byte_order = IMAGE_BYTE_ORDER;
+        header.array_count = static_cast<uint32_t>(table.size());
+        header.size = offset;
+        header.checksum = image_checksum(data, offset);
+        std::memcpy(data, &header, sizeof(header));
+        return image;
+    }
+
+    // handles of the values ordered by id
+    template<typename T>
+    std::vector<uint32_t> sorted_handles(ds::value_by_id<T> const& values) {
+        std::vector<uint32_t> handles(values.size());
+        for (uint32_t handle = 0 ; handle < handles.size() ; ++handle) {
+            handles[handle] = handle;
+        }
+        std::sort(handles.begin(), handles.end(), [&](uint32_t l, uint32_t r) {
+            return values.id(l) < values.id(r);
+        });
+        return handles;
+    }
+
+    // timetable index of an entity, indices are kept by handle
+    template<typename T>
+    uint32_t index_of(ds::value_by_id<T> const& values, std::vector<uint32_t> const& indices, boost::string_view id) {
+        return indices[values.find(id)];
+    }
+
+    void add(ds::strings_t<ds::vector_t>& strings, boost::string_view value) {
+        if (strings.offsets.empty()) {
+            strings.offsets.push_back(0);
+        }
+        strings.chars.insert(strings.chars.end(), value.cbegin(), value.cend());
+        strings.offsets.push_back(static_cast<uint32_t>(strings.chars.size()));
+    }
+
+    // groups are visited in the order of their stop sequences, so a feed always gives the same patterns
+    void add_patterns(ds::timetable_arrays_t<ds::vector_t>& timetable) {
+        auto const trip_count = timetable.trip_routes.size();
+        auto const& begins = timetable.trip_stop_times_begin;
+        auto const& arrivals = timetable.stop_time_arrivals;
+        auto const& departures = timetable.stop_time_departures;
+        std::map<std::vector<uint32_t>, std::vector<uint32_t>> trips_by_stops;
+        for (uint32_t trip = 0 ; trip < trip_count ; ++trip) {
+            if (begins[trip + 1] - begins[trip] < 2) {
+                continue;
+            }
+            trips_by_stops[std::vector<uint32_t>(timetable.stop_time_stops.cbegin() + begins[trip],
+                    timetable.stop_time_stops.cbegin() + begins[trip + 1])].push_back(trip);
+        }
+
+        timetable.trip_patterns.assign(trip_count, ds::NO_INDEX);
+        timetable.trip_pattern_ranks.assign(trip_count, ds::NO_INDEX);
+        std::vector<std::vector<std::pair<uint32_t, uint32_t>>> stop_patterns(timetable.stop_ids.size());
+        std::vector<std::vector<uint32_t>> split;
+        for (auto& group : trips_by_stops) {
+            auto const& stops = group.first;
+            auto& group_trips = group.second;
+            std::stable_sort(group_trips.begin(), group_trips.end(), [&](uint32_t l, uint32_t r) {
+                return departures[begins[l]] < departures[begins[r]];
+            });
+            // a trip overtaking the last trip of a pattern starts another one, otherwise the departures at
+            // some stop would not be sorted and boarding could not use binary search
+            split.clear();
+            for (auto trip : group_trips) {
+                auto target = split.size();
+                for (size_t p = 0 ; p < split.size() ; ++p) {
+                    auto const last = begins[split[p].back()];
+                    bool overtakes = false;
+                    for (size_t i = 0 ; i < stops.size() && !overtakes ; ++i) {
+                        overtakes = arrivals[begins[trip] + i] < arrivals[last + i]
+                                || departures[begins[trip] + i] < departures[last + i];
+                    }
+                    if (!overtakes) {
+                        target = p;
+                        break;
+                    }
+                }
+                if (target == split.size()) {
+                    split.emplace_back();
+                }
+                split[target].push_back(trip);
+            }
+            for (auto const& pattern_trips : split) {
+                auto const pattern = static_cast<uint32_t>(timetable.pattern_trips_begin.size());
+                timetable.pattern_trips_begin.push_back(timetable.pattern_trips.size());
+                for (auto trip : pattern_trips) {
+                    timetable.trip_patterns[trip] = pattern;
+                    timetable.trip_pattern_ranks[trip] = timetable.pattern_trips.size();
+                    timetable.pattern_trips.push_back(trip);
+                }
+                timetable.pattern_stops_begin.push_back(timetable.pattern_stops.size());
+                timetable.pattern_times_begin.push_back(timetable.pattern_arrivals.size());
+                for (uint32_t i = 0 ; i < stops.size() ; ++i) {
+                    timetable.pattern_stops.push_back(stops[i]);
+                    stop_patterns[stops[i]].emplace_back(pattern, i);
+                    for (auto trip : pattern_trips) {
+                        timetable.pattern_arrivals.push_back(arrivals[begins[trip] + i]);
+                        timetable.pattern_departures.push_back(departures[begins[trip] + i]);
+                    }
+                }
+            }
+        }
+        timetable.pattern_trips_begin.push_back(timetable.pattern_trips.size());
+        timetable.pattern_stops_begin.push_back(timetable.pattern_stops.size());
+        timetable.pattern_times_begin.push_back(timetable.pattern_arrivals.size());
+
+        for (auto const& patterns : stop_patterns) {
+            timetable.stop_patterns_begin.push_back(timetable.stop_patterns.size());
+            for (auto const& pattern : patterns) {
+                timetable.stop_patterns.push_back(pattern.first);
+                timetable.stop_pattern_positions.push_back(pattern.second);
+            }
+        }
+        timetable.stop_patterns_begin.push_back(timetable.stop_patterns.size());
+    }
+
+    uint32_t find_index(ds::strings_t<ds::array_view_t> const& ids, std::string const& id) {
+        boost::string_view const key(id);
+        uint32_t low = 0, high = ids.size();
+        while (low < high) {
+            auto const middle = (low + high) / 2;
+            if (ids[middle] < key) {
+                low = middle + 1;
+            } else {
+                high = middle;
+            }
+        }
+        return low < ids.size() && ids[low] == key ? low : ds::NO_INDEX;
+    }
+}
+
+namespace data_structures {
+
+    timetable_t::timetable_t(image_ptr image, bool verify_checksum) : image(std::move(image)) {
+        auto const data = this->image->data();
+        auto const size = this->image->size();
+        image_header_t header;
+        if (size < sizeof(header)) {
+            throw std::runtime_error("Timetable image is truncated");
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0 || header.byte_order != IMAGE_BYTE_ORDER) {
+            throw std::runtime_error("Not a timetable image or built on another platform");
+        }
+        if (header.version != TIMETABLE_VERSION) {
+            throw std::runtime_error("Timetable image version " + std::to_string(header.version)
+                    + " does not match expected version " + std::to_string(TIMETABLE_VERSION));
+        }
+        uint32_t array_count = 0;
+        visit(*this, [&](auto&) {
+            ++array_count;
+        });
+        if (header.size != size || header.array_count != array_count
+                || size < sizeof(header) + array_count * sizeof(image_array_t)) {
+            throw std::runtime_error("Timetable image is truncated");
+        }
+        if (verify_checksum && image_checksum(data, size) != header.checksum) {
+            throw std::runtime_error("Timetable image checksum mismatch");
+        }
+        size_t i = 0;
+        visit(*this, [&](auto& view) {
+            using value_t = typename std::decay_t<decltype(view)>::value_type;
+            image_array_t entry;
+            std::memcpy(&entry, data + sizeof(header) + i++ * sizeof(entry), sizeof(entry));
+            if (entry.element_size != sizeof(value_t) || entry.offset % alignof(value_t) != 0
+                    || entry.offset > size || entry.count > (size - entry.offset) / sizeof(value_t)) {
+                throw std::runtime_error("Timetable image is damaged");
+            }
+            view = array_view_t<value_t>(reinterpret_cast<value_t const*>(data + entry.offset), entry.count);
+        });
+    }
+
+    uint32_t timetable_t::find_stop(std::string const& id) const {
+        return find_index(stop_ids, id);
+    }
+
+    uint32_t timetable_t::find_trip(std::string const& id) const {
+        return find_index(trip_ids, id);
+    }
+
+    timetable_t compile_timetable(
+            value_by_id<route_ptr> const& routes,
+            value_by_id<service_ptr> const& services,
+            value_by_id<stop_ptr> const& stops,
+            value_by_id<trip_ptr> const& trips,
+            compile_options_t const& options) {
+        timetable_arrays_t<vector_t> timetable;
+
+        std::vector<uint32_t> route_indices(routes.size());
+        for (auto handle : sorted_handles(routes)) {
+            auto const& route = routes[handle];
+            route_indices[handle] = timetable.route_ids.size();
+            add(timetable.route_ids, route->id);
+            add(timetable.route_short_names, route->short_name);
+            add(timetable.route_long_names, route->long_name);
+            add(timetable.route_descs, route->desc);
+            timetable.route_types.push_back(route->type);
+        }
+
+        std::vector<uint32_t> service_indices(services.size());
+        uint32_t service_bits = 0;
+        for (auto handle : sorted_handles(services)) {
+            auto const& service = services[handle];
+            service_indices[handle] = timetable.service_ids.size();
+            add(timetable.service_ids, service->id);
+            auto first = service->start;
+            auto last = service->end;
+            for (auto const exception : service->exceptions) {
+                if (exception->type == 1) {
+                    first = std::min(first, exception->date);
+                    last = std::max(last, exception->date);
+                }
+            }
+            auto const first_day = static_cast<int32_t>(first.day_number());
+            auto const length = last < first ? 0 : static_cast<uint32_t>((last - first).days() + 1);
+            timetable.service_first_days.push_back(first_day);
+            timetable.service_days_begin.push_back(service_bits);
+            service_bits += length;
+            timetable.service_days.resize((service_bits + 63) / 64, 0);
+            auto set_day = [&](date_t const& date, bool active) {
+                auto const bit = timetable.service_days_begin.back() + (date.day_number() - first_day);
+                if (active) {
+                    timetable.service_days[bit / 64] |= uint64_t(1) << (bit % 64);
+                } else {
+                    timetable.service_days[bit / 64] &= ~(uint64_t(1) << (bit % 64));
+                }
+            };
+            if (!(service->end < service->start)) {
+                for (boost::gregorian::day_iterator day(service->start) ; *day <= service->end ; ++day) {
+                    if (((service->week_days >> day->day_of_week().as_number()) & 1u) != 0) {
+                        set_day(*day, true);
+                    }
+                }
+            }
+            for (auto const exception : service->exceptions) {
+                if (exception->type == 1) {
+                    set_day(exception->date, true);
+                } else if (exception->type == 2 && first <= exception->date && exception->date <= last) {
+                    set_day(exception->date, false);
+                }
+            }
+        }
+        timetable.service_days_begin.push_back(service_bits);
+
+        auto const stop_handles = sorted_handles(stops);
+        std::vector<uint32_t> stop_indices(stops.size());
+        for (auto handle : stop_handles) {
+            auto const& stop = stops[handle];
+            stop_indices[handle] = timetable.stop_ids.size();
+            add(timetable.stop_ids, stop->id);
+            add(timetable.stop_names, stop->name);
+            timetable.stop_latitudes.push_back(bg::get<0>(stop->location));
+            timetable.stop_longitudes.push_back(bg::get<1>(stop->location));
+        }
+        for (auto handle : stop_handles) {
+            auto const& stop = stops[handle];
+            timetable.stop_parents.push_back(stop->parent ? index_of(stops, stop_indices, stop->parent->id) : NO_INDEX);
+            timetable.stop_transfers_begin.push_back(timetable.transfer_targets.size());
+            for (auto const& transfer : stop->transfers) {
+                timetable.transfer_targets.push_back(index_of(stops, stop_indices, transfer->to->id));
+                timetable.transfer_types.push_back(transfer->type);
+                timetable.transfer_durations.push_back(transfer->duration);
+            }
+        }
+        timetable.stop_transfers_begin.push_back(timetable.transfer_targets.size());
+
+        for (auto handle : sorted_handles(trips)) {
+            auto const& trip = trips[handle];
+            auto const index = timetable.trip_ids.size();
+            add(timetable.trip_ids, trip->id);
+            timetable.trip_routes.push_back(index_of(routes, route_indices, trip->route->id));
+            timetable.trip_services.push_back(index_of(services, service_indices, trip->service->id));
+            add(timetable.trip_head_signs, trip->head_sign);
+            add(timetable.trip_short_names, trip->short_name);
+            timetable.trip_directions.push_back(trip->direction);
+            timetable.trip_stop_times_begin.push_back(timetable.stop_time_stops.size());
+            for (auto const& stop_time : trip->stop_times) {
+                timetable.stop_time_stops.push_back(index_of(stops, stop_indices, stop_time->stop->id));
+                timetable.stop_time_trips.push_back(index);
+                timetable.stop_time_sequences.push_back(stop_time->sequence);
+                timetable.stop_time_arrivals.push_back(stop_time->arrival);
+                timetable.stop_time_departures.push_back(stop_time->departure);
+            }
+        }
+        timetable.trip_stop_times_begin.push_back(timetable.stop_time_stops.size());
+
+        auto const stop_count = timetable.stop_ids.size();
+        timetable.stop_departures_begin.assign(stop_count + 1, 0);
+        for (auto stop : timetable.stop_time_stops) {
+            ++timetable.stop_departures_begin[stop + 1];
+        }
+        for (size_t i = 1 ; i < timetable.stop_departures_begin.size() ; ++i) {
+            timetable.stop_departures_begin[i] += timetable.stop_departures_begin[i - 1];
+        }
+        timetable.departures.resize(timetable.stop_time_stops.size());
+        auto fill = timetable.stop_departures_begin;
+        for (uint32_t i = 0 ; i < timetable.stop_time_stops.size() ; ++i) {
+            timetable.departures[fill[timetable.stop_time_stops[i]]++] = i;
+        }
+        for (uint32_t stop = 0 ; stop < stop_count ; ++stop) {
+            std::stable_sort(timetable.departures.begin() + timetable.stop_departures_begin[stop],
+                    timetable.departures.begin() + timetable.stop_departures_begin[stop + 1],
+                    [&](uint32_t l, uint32_t r) {
+                return timetable.stop_time_departures[l] < timetable.stop_time_departures[r];
+            });
+        }
+        add_patterns(timetable);
+        if (!options.trip_transfers) {
+            return timetable_t(pack(timetable), false);
+        }
+
+        // transfers are computed on the packed timetable and the image is packed again with them
+        auto transfers = compute_trip_transfers(timetable_t(pack(timetable), false), options.threads);
+        timetable.stop_time_transfers_begin = std::move(transfers.stop_time_transfers_begin);
+        timetable.trip_transfer_stop_times = std::move(transfers.stop_times);
+        timetable.trip_transfer_days = std::move(transfers.days);
+        return timetable_t(pack(timetable), false);
+    }
+}
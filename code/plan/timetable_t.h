@@ -0,0 +1,304 @@
+#ifndef PLANNER_TIMETABLE_T_H
+#define PLANNER_TIMETABLE_T_H
+
+#include "structures.h"
+
+#include <boost/utility/string_view.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace data_structures {
+
+    // bump on every change of the arrays below or of their order, old snapshots are rejected then
+    constexpr uint32_t TIMETABLE_VERSION = 3;
+
+    template<typename T>
+    using vector_t = std::vector<T>;
+
+    // read only window into memory owned by an image_t
+    template<typename T>
+    class array_view_t {
+        T const* items = nullptr;
+        size_t count = 0;
+    public:
+        using value_type = T;
+
+        array_view_t() = default;
+
+        array_view_t(T const* items, size_t count) : items(items), count(count) {
+        }
+
+        T const& operator[](size_t i) const {
+            return items[i];
+        }
+
+        size_t size() const {
+            return count;
+        }
+
+        bool empty() const {
+            return count == 0;
+        }
+
+        T const* data() const {
+            return items;
+        }
+
+        T const* begin() const {
+            return items;
+        }
+
+        T const* end() const {
+            return items + count;
+        }
+
+        T const* cbegin() const {
+            return items;
+        }
+
+        T const* cend() const {
+            return items + count;
+        }
+    };
+
+    // strings concatenated into chars, string i is [offsets[i], offsets[i + 1])
+    template<template<typename> class array>
+    struct strings_t {
+        array<uint32_t> offsets;
+        array<char> chars;
+
+        uint32_t size() const {
+            return offsets.empty() ? 0 : static_cast<uint32_t>(offsets.size() - 1);
+        }
+
+        boost::string_view operator[](size_t i) const {
+            return boost::string_view(chars.data() + offsets[i], offsets[i + 1] - offsets[i]);
+        }
+    };
+
+    // Compact copy of the parsed feed used by routing. Every entity is addressed by a dense index and its
+    // attributes live in parallel arrays. Related entities are stored as ranges: *_begin arrays have one
+    // element more than their owners and entity i owns [begin[i], begin[i + 1]). Ids are sorted, so the index
+    // of an id is found by binary search.
+    template<template<typename> class array>
+    struct timetable_arrays_t {
+        strings_t<array> route_ids;
+        strings_t<array> route_short_names;
+        strings_t<array> route_long_names;
+        strings_t<array> route_descs;
+        array<int32_t> route_types;
+
+        strings_t<array> service_ids;
+        // every service has a bit per day from its first day (day number) on, with calendar_dates
+        // additions and removals already applied. service_days_begin are bit offsets into service_days
+        array<int32_t> service_first_days;
+        array<uint32_t> service_days_begin;
+        array<uint64_t> service_days;
+
+        strings_t<array> stop_ids;
+        strings_t<array> stop_names;
+        array<double> stop_latitudes;
+        array<double> stop_longitudes;
+        array<uint32_t> stop_parents;
+        array<uint32_t> stop_transfers_begin;
+        array<uint32_t> stop_departures_begin;
+
+        array<uint32_t> transfer_targets;
+        array<int32_t> transfer_types;
+        array<seconds_t> transfer_durations;
+
+        array<uint32_t> departures; // stop time indices grouped by stop and sorted by departure
+
+        strings_t<array> trip_ids;
+        array<uint32_t> trip_routes;
+        array<uint32_t> trip_services;
+        strings_t<array> trip_head_signs;
+        strings_t<array> trip_short_names;
+        array<int32_t> trip_directions;
+        array<uint32_t> trip_stop_times_begin;
+
+        // grouped by trip and sorted by sequence inside it
+        array<uint32_t> stop_time_stops;
+        array<uint32_t> stop_time_trips;
+        array<int32_t> stop_time_sequences;
+        array<seconds_t> stop_time_arrivals;
+        array<seconds_t> stop_time_departures;
+
+        // trips visiting the same stops in the same order, split so that no trip overtakes another: the trips
+        // of a pattern are sorted by departure at every one of its stops. Trips with less than two stop times
+        // have no pattern
+        array<uint32_t> pattern_trips_begin;
+        array<uint32_t> pattern_trips;
+        array<uint32_t> pattern_stops_begin;
+        array<uint32_t> pattern_stops;
+        // times of every pattern as a dense matrix from pattern_times_begin on. Stop major, the times of all
+        // trips at one stop are a sorted column, see pattern_time
+        array<uint32_t> pattern_times_begin;
+        array<seconds_t> pattern_arrivals;
+        array<seconds_t> pattern_departures;
+        array<uint32_t> trip_patterns;
+        array<uint32_t> trip_pattern_ranks; // position of every trip in pattern_trips
+        array<uint32_t> stop_patterns_begin;
+        array<uint32_t> stop_patterns;
+        array<uint32_t> stop_pattern_positions;
+
+        // trip to trip transfers of the trip based router by the stop time alighted at, only compiled on demand.
+        // A transfer boards the trip of its stop time on the service day shifted by its day from the one alighted
+        array<uint32_t> stop_time_transfers_begin;
+        array<uint32_t> trip_transfer_stop_times;
+        array<int8_t> trip_transfer_days;
+
+        // calls visitor for every array, in the order they are laid out in an image
+        template<typename self_t, typename visitor_t>
+        static void visit(self_t& self, visitor_t&& visitor) {
+            visit_strings(self.route_ids, visitor);
+            visit_strings(self.route_short_names, visitor);
+            visit_strings(self.route_long_names, visitor);
+            visit_strings(self.route_descs, visitor);
+            visitor(self.route_types);
+            visit_strings(self.service_ids, visitor);
+            visitor(self.service_first_days);
+            visitor(self.service_days_begin);
+            visitor(self.service_days);
+            visit_strings(self.stop_ids, visitor);
+            visit_strings(self.stop_names, visitor);
+            visitor(self.stop_latitudes);
+            visitor(self.stop_longitudes);
+            visitor(self.stop_parents);
+            visitor(self.stop_transfers_begin);
+            visitor(self.stop_departures_begin);
+            visitor(self.transfer_targets);
+            visitor(self.transfer_types);
+            visitor(self.transfer_durations);
+            visitor(self.departures);
+            visit_strings(self.trip_ids, visitor);
+            visitor(self.trip_routes);
+            visitor(self.trip_services);
+            visit_strings(self.trip_head_signs, visitor);
+            visit_strings(self.trip_short_names, visitor);
+            visitor(self.trip_directions);
+            visitor(self.trip_stop_times_begin);
+            visitor(self.stop_time_stops);
+            visitor(self.stop_time_trips);
+            visitor(self.stop_time_sequences);
+            visitor(self.stop_time_arrivals);
+            visitor(self.stop_time_departures);
+            visitor(self.pattern_trips_begin);
+            visitor(self.pattern_trips);
+            visitor(self.pattern_stops_begin);
+            visitor(self.pattern_stops);
+            visitor(self.pattern_times_begin);
+            visitor(self.pattern_arrivals);
+            visitor(self.pattern_departures);
+            visitor(self.trip_patterns);
+            visitor(self.trip_pattern_ranks);
+            visitor(self.stop_patterns_begin);
+            visitor(self.stop_patterns);
+            visitor(self.stop_pattern_positions);
+            visitor(self.stop_time_transfers_begin);
+            visitor(self.trip_transfer_stop_times);
+            visitor(self.trip_transfer_days);
+        }
+
+    private:
+        template<typename strings_type, typename visitor_t>
+        static void visit_strings(strings_type& strings, visitor_t& visitor) {
+            visitor(strings.offsets);
+            visitor(strings.chars);
+        }
+    };
+
+    // Contiguous memory holding a serialized timetable: a header, a table of array offsets and the arrays
+    // themselves. The same bytes are used in memory right after compilation and mapped from a snapshot file.
+    class image_t {
+    public:
+        virtual ~image_t() = default;
+
+        virtual char const* data() const = 0;
+
+        virtual size_t size() const = 0;
+    };
+
+    using image_ptr = std::shared_ptr<image_t const>;
+
+    struct timetable_t : timetable_arrays_t<array_view_t> {
+        image_ptr image;
+
+        timetable_t() = default;
+
+        // binds all arrays to the image, throws when the image is damaged or of another version
+        explicit timetable_t(image_ptr image, bool verify_checksum = true);
+
+        uint32_t stop_count() const {
+            return stop_ids.size();
+        }
+
+        uint32_t trip_count() const {
+            return trip_ids.size();
+        }
+
+        uint32_t pattern_count() const {
+            return pattern_trips_begin.empty() ? 0 : static_cast<uint32_t>(pattern_trips_begin.size() - 1);
+        }
+
+        uint32_t pattern_width(uint32_t pattern) const {
+            return pattern_stops_begin[pattern + 1] - pattern_stops_begin[pattern];
+        }
+
+        uint32_t pattern_trip_count(uint32_t pattern) const {
+            return pattern_trips_begin[pattern + 1] - pattern_trips_begin[pattern];
+        }
+
+        // index into pattern_arrivals and pattern_departures of the trip of the rank at the stop position
+        size_t pattern_time(uint32_t pattern, uint32_t position, uint32_t rank) const {
+            return pattern_times_begin[pattern] + size_t(position) * pattern_trip_count(pattern) + rank;
+        }
+
+        bool has_trip_transfers() const {
+            return !stop_time_transfers_begin.empty();
+        }
+
+        uint32_t find_stop(std::string const& id) const;
+
+        uint32_t find_trip(std::string const& id) const;
+
+        bool is_service_active(uint32_t service, int32_t day_number) const {
+            auto const day = static_cast<uint32_t>(day_number - service_first_days[service]);
+            if (day >= service_days_begin[service + 1] - service_days_begin[service]) {
+                return false;
+            }
+            auto const bit = service_days_begin[service] + day;
+            return ((service_days[bit / 64] >> (bit % 64)) & 1u) != 0;
+        }
+
+        bool is_service_active(uint32_t service, date_t const& date) const {
+            return is_service_active(service, static_cast<int32_t>(date.day_number()));
+        }
+    };
+
+    struct compile_options_t {
+        unsigned threads = 1;
+        // trip to trip transfers for the trip based router, by far the most expensive part of compiling
+        bool trip_transfers = false;
+    };
+
+    timetable_t compile_timetable(
+            value_by_id<route_ptr> const& routes,
+            value_by_id<service_ptr> const& services,
+            value_by_id<stop_ptr> const& stops,
+            value_by_id<trip_ptr> const& trips,
+            compile_options_t const& options = compile_options_t());
+
+    struct path_leg_t {
+        date_time_t arrival;
+        uint32_t stop;
+        uint32_t transport = NO_INDEX; // stop time the stop was reached with
+        uint32_t transfer = NO_INDEX; // transfer or transport is set. not both at the same time
+    };
+}
+
+#endif //PLANNER_TIMETABLE_T_H
@@ -0,0 +1,59 @@
+#include "travel_time_bound_t.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace ds = data_structures;
+
+namespace {
+    constexpr double EARTH_RADIUS = 6371008.8; // mean radius in meters
+    constexpr double RADIANS = 3.14159265358979323846 / 180;
+    // rounding of the distances must not break the triangle inequality the bound relies on
+    constexpr double ROUNDING_MARGIN = 1 - 1e-9;
+
+    // haversine distance in meters
+    double distance(ds::timetable_t const& timetable, uint32_t from, uint32_t to) {
+        auto const from_latitude = timetable.stop_latitudes[from] * RADIANS;
+        auto const to_latitude = timetable.stop_latitudes[to] * RADIANS;
+        auto const latitude = std::sin((to_latitude - from_latitude) / 2);
+        auto const longitude = std::sin((timetable.stop_longitudes[to] - timetable.stop_longitudes[from])
+                * RADIANS / 2);
+        auto const a = latitude * latitude + std::cos(from_latitude) * std::cos(to_latitude) * longitude * longitude;
+        return 2 * EARTH_RADIUS * std::asin(std::min(1.0, std::sqrt(a)));
+    }
+}
+
+namespace processing {
+
+    travel_time_bound_t::travel_time_bound_t(ds::timetable_t const& timetable) : seconds_per_meter(0) {
+        double fastest = 0;
+        auto add = [&](uint32_t from, uint32_t to, ds::seconds_t duration) {
+            auto const meters = distance(timetable, from, to);
+            if (meters > 0) {
+                fastest = duration > 0 ? std::max(fastest, meters / duration) : INFINITY;
+            }
+        };
+        for (uint32_t trip = 0 ; trip < timetable.trip_count() ; ++trip) {
+            auto const end = timetable.trip_stop_times_begin[trip + 1];
+            for (auto stop_time = timetable.trip_stop_times_begin[trip] ; stop_time + 1 < end ; ++stop_time) {
+                add(timetable.stop_time_stops[stop_time], timetable.stop_time_stops[stop_time + 1],
+                        timetable.stop_time_arrivals[stop_time + 1] - timetable.stop_time_departures[stop_time]);
+            }
+        }
+        for (uint32_t stop = 0 ; stop < timetable.stop_count() ; ++stop) {
+            for (auto transfer = timetable.stop_transfers_begin[stop] ;
+                    transfer < timetable.stop_transfers_begin[stop + 1] ; ++transfer) {
+                add(stop, timetable.transfer_targets[transfer], timetable.transfer_durations[transfer]);
+            }
+        }
+        if (fastest > 0 && std::isfinite(fastest)) {
+            seconds_per_meter = ROUNDING_MARGIN / fastest;
+        }
+    }
+
+    ds::seconds_t travel_time_bound_t::operator()(ds::timetable_t const& timetable, uint32_t from,
+            uint32_t to) const {
+        return static_cast<ds::seconds_t>(distance(timetable, from, to) * seconds_per_meter);
+    }
+
+}
@@ -0,0 +1,25 @@
+#ifndef PLANNER_TRAVEL_TIME_BOUND_T_H
+#define PLANNER_TRAVEL_TIME_BOUND_T_H
+
+#include "timetable_t.h"
+
+#include <cstdint>
+
+namespace processing {
+
+    // Lower bound of the time needed between two stops for A*: their great-circle distance over the fastest
+    // speed of any vehicle or footpath of the timetable. Every stop time and footpath takes at least the bound
+    // of the stops it joins, so the bound never overestimates and stops settle in order of arrival like in
+    // Dijkstra. A feed moving some distance in no time leaves no useful speed, the bound is then always zero
+    class travel_time_bound_t {
+        double seconds_per_meter;
+    public:
+        explicit travel_time_bound_t(data_structures::timetable_t const& timetable);
+
+        data_structures::seconds_t operator()(data_structures::timetable_t const& timetable, uint32_t from,
+                uint32_t to) const;
+    };
+
+}
+
+#endif //PLANNER_TRAVEL_TIME_BOUND_T_H
@@ -0,0 +1,260 @@
+#include "trip_based_t.h"
+
+#include <algorithm>
+#include <exception>
+
+namespace ds = data_structures;
+
+namespace processing {
+
+    trip_based_t::trip_based_t(ds::timetable_t const& timetable) : max_day_span(0) {
+        for (auto departure : timetable.stop_time_departures) {
+            max_day_span = std::max(max_day_span, departure / ds::DAY_SECONDS);
+        }
+        auto const stop_count = timetable.stop_count();
+        incoming_transfers_begin.assign(stop_count + 1, 0);
+        for (auto to : timetable.transfer_targets) {
+            ++incoming_transfers_begin[to + 1];
+        }
+        for (size_t i = 1 ; i < incoming_transfers_begin.size() ; ++i) {
+            incoming_transfers_begin[i] += incoming_transfers_begin[i - 1];
+        }
+        incoming_transfers.resize(timetable.transfer_targets.size());
+        incoming_transfer_stops.resize(timetable.transfer_targets.size());
+        auto fill = incoming_transfers_begin;
+        for (uint32_t stop = 0 ; stop < stop_count ; ++stop) {
+            for (auto transfer = timetable.stop_transfers_begin[stop] ;
+                    transfer < timetable.stop_transfers_begin[stop + 1] ; ++transfer) {
+                auto const i = fill[timetable.transfer_targets[transfer]]++;
+                incoming_transfers[i] = transfer;
+                incoming_transfer_stops[i] = stop;
+            }
+        }
+    }
+
+    // Like the other engines a trip is only boarded on the service day of the earliest arrival at its stop or the
+    // day after it, which bounds the search by the latest day reached. The first trips are the earliest ones of
+    // every pattern at the source and the stops one footpath away, for every service day that may still run
+    // there. Transfers are only taken from the earliest trip at a stop, a later one boards nothing earlier
+    auto trip_based_t::search(ds::timetable_t const& timetable, uint32_t source, uint32_t target,
+            int32_t query_day_number, ds::seconds_t departure, query_context_t::trip_based_state_t& context) const
+            -> result_t {
+        context.reset(timetable, timetable.pattern_stops.size(), ds::day_offset(departure) - max_day_span);
+        auto& segments = context.segments;
+        auto& final_walks = context.final_walks;
+        auto& arrivals = context.arrivals;
+        result_t best;
+
+        // later trips of a pattern are later at every stop, so a trip reached at a stop cuts all of them there
+        auto enqueue = [&](uint32_t trip, int32_t day, uint32_t position, uint32_t parent, uint32_t alighted,
+                uint32_t walk) {
+            auto const pattern = timetable.trip_patterns[trip];
+            auto const rank = timetable.trip_pattern_ranks[trip] - timetable.pattern_trips_begin[pattern];
+            auto const slots = timetable.pattern_stops_begin[pattern];
+            auto const width = timetable.pattern_width(pattern);
+            auto reached = width - 1;
+            for (uint32_t i = 0 ; i < width - 1 ; ++i) {
+                if (context.reached_rank(slots + i, day) <= rank) {
+                    reached = i;
+                    break;
+                }
+            }
+            if (position >= reached) {
+                return;
+            }
+            segments.push_back(trip_segment_t{trip, day, position, reached, parent, alighted, walk});
+            context.reach(slots + position, day, rank);
+        };
+
+        auto reach = [&](uint32_t stop, ds::seconds_t time) {
+            if (time < context.alightings[stop]) {
+                context.alightings.set(stop) = time;
+            }
+            if (time < arrivals[stop]) {
+                arrivals.set(stop) = time;
+            }
+            for (auto transfer = timetable.stop_transfers_begin[stop] ;
+                    transfer < timetable.stop_transfers_begin[stop + 1] ; ++transfer) {
+                auto const to = timetable.transfer_targets[transfer];
+                auto const walked = time + timetable.transfer_durations[transfer];
+                if (walked < arrivals[to]) {
+                    arrivals.set(to) = walked;
+                }
+            }
+        };
+
+        auto board = [&](uint32_t stop, ds::seconds_t time, uint32_t walk) {
+            auto const today = ds::day_offset(time);
+            for (auto i = timetable.stop_patterns_begin[stop] ; i < timetable.stop_patterns_begin[stop + 1] ; ++i) {
+                auto const pattern = timetable.stop_patterns[i];
+                auto const position = timetable.stop_pattern_positions[i];
+                auto const trips_begin = timetable.pattern_trips_begin[pattern];
+                if (position + 1 == timetable.pattern_width(pattern)) {
+                    continue;
+                }
+                auto const column = timetable.pattern_departures.cbegin() + timetable.pattern_time(pattern, position, 0);
+                auto const trip_count = timetable.pattern_trip_count(pattern);
+                for (auto day = today - max_day_span ; day <= today + 1 ; ++day) {
+                    auto const local = time - day * ds::DAY_SECONDS;
+                    auto rank = static_cast<uint32_t>(std::lower_bound(column, column + trip_count, local) - column);
+                    for ( ; rank < trip_count ; ++rank) {
+                        auto const trip = timetable.pattern_trips[trips_begin + rank];
+                        if (timetable.is_service_active(timetable.trip_services[trip], query_day_number + day)) {
+                            enqueue(trip, day, position, ds::NO_INDEX, 0, walk);
+                            break;
+                        }
+                    }
+                }
+            }
+        };
+
+        reach(source, departure);
+        if (target != ds::NO_INDEX) {
+            final_walks.set(target) = std::make_pair(0, ds::NO_INDEX);
+            for (auto i = incoming_transfers_begin[target] ; i < incoming_transfers_begin[target + 1] ; ++i) {
+                auto const duration = timetable.transfer_durations[incoming_transfers[i]];
+                if (duration < final_walks[incoming_transfer_stops[i]].first) {
+                    final_walks.set(incoming_transfer_stops[i]) = std::make_pair(duration, incoming_transfers[i]);
+                }
+            }
+            if (final_walks[source].first != INFINITE_TIME) {
+                best.arrival = departure + final_walks[source].first;
+                best.walk = final_walks[source].second;
+            }
+        }
+        board(source, departure, ds::NO_INDEX);
+        for (auto transfer = timetable.stop_transfers_begin[source] ;
+                transfer < timetable.stop_transfers_begin[source + 1] ; ++transfer) {
+            board(timetable.transfer_targets[transfer], departure + timetable.transfer_durations[transfer], transfer);
+        }
+
+        // like a round of raptor a level first reaches its stops and only then boards from the earliest arrivals
+        for (size_t level_begin = 0 ; level_begin < segments.size() ; ) {
+            auto const level_end = segments.size();
+            for (auto s = level_begin ; s < level_end ; ++s) {
+                auto const segment = segments[s];
+                auto const first = timetable.trip_stop_times_begin[segment.trip];
+                for (auto position = segment.begin + 1 ; position <= segment.end ; ++position) {
+                    auto const arrival = segment.day * ds::DAY_SECONDS + timetable.stop_time_arrivals[first + position];
+                    if (arrival >= best.arrival) {
+                        break;
+                    }
+                    auto const stop = timetable.stop_time_stops[first + position];
+                    reach(stop, arrival);
+                    if (target != ds::NO_INDEX && final_walks[stop].first != INFINITE_TIME
+                            && arrival + final_walks[stop].first < best.arrival) {
+                        best.arrival = arrival + final_walks[stop].first;
+                        best.segment = static_cast<uint32_t>(s);
+                        best.position = position;
+                        best.walk = final_walks[stop].second;
+                    }
+                }
+            }
+            for (auto s = level_begin ; s < level_end ; ++s) {
+                auto const segment = segments[s];
+                auto const first = timetable.trip_stop_times_begin[segment.trip];
+                for (auto position = segment.begin + 1 ; position <= segment.end ; ++position) {
+                    auto const stop_time = first + position;
+                    auto const arrival = segment.day * ds::DAY_SECONDS + timetable.stop_time_arrivals[stop_time];
+                    if (arrival >= best.arrival) {
+                        break;
+                    }
+                    if (arrival > context.alightings[timetable.stop_time_stops[stop_time]]) {
+                        continue;
+                    }
+                    for (auto transfer = timetable.stop_time_transfers_begin[stop_time] ;
+                            transfer < timetable.stop_time_transfers_begin[stop_time + 1] ; ++transfer) {
+                        auto const boarded = timetable.trip_transfer_stop_times[transfer];
+                        auto const day = segment.day + timetable.trip_transfer_days[transfer];
+                        if (day > ds::day_offset(arrivals[timetable.stop_time_stops[boarded]]) + 1
+                                || day * ds::DAY_SECONDS + timetable.stop_time_arrivals[boarded + 1] >= best.arrival) {
+                            continue;
+                        }
+                        auto const trip = timetable.stop_time_trips[boarded];
+                        if (timetable.is_service_active(timetable.trip_services[trip], query_day_number + day)) {
+                            enqueue(trip, day, boarded - timetable.trip_stop_times_begin[trip],
+                                    static_cast<uint32_t>(s), position, ds::NO_INDEX);
+                        }
+                    }
+                }
+            }
+            level_begin = level_end;
+        }
+        return best;
+    }
+
+    std::vector<ds::path_leg_t> trip_based_t::journey(ds::timetable_t const& timetable, uint32_t source,
+            uint32_t target, ds::date_time_t const& departure, query_context_t::trip_based_state_t& context) const {
+        auto const query_day = departure.date();
+        auto const start = ds::seconds_since(query_day, departure);
+        auto const best = search(timetable, source, target, static_cast<int32_t>(query_day.day_number()), start,
+                context);
+        if (best.arrival == INFINITE_TIME) {
+            throw std::runtime_error("Unable to find connection");
+        }
+
+        std::vector<ds::path_leg_t> legs;
+        auto add_leg = [&](uint32_t stop, ds::seconds_t arrival, uint32_t transport, uint32_t transfer) {
+            ds::path_leg_t leg;
+            leg.arrival = ds::to_date_time(query_day, arrival);
+            leg.stop = stop;
+            leg.transport = transport;
+            leg.transfer = transfer;
+            legs.push_back(leg);
+        };
+        if (best.walk != ds::NO_INDEX) {
+            add_leg(target, best.arrival, ds::NO_INDEX, best.walk);
+        }
+        auto position = best.position;
+        for (auto s = best.segment ; s != ds::NO_INDEX ; ) {
+            auto const& segment = context.segments[s];
+            auto const first = timetable.trip_stop_times_begin[segment.trip];
+            add_leg(timetable.stop_time_stops[first + position],
+                    segment.day * ds::DAY_SECONDS + timetable.stop_time_arrivals[first + position],
+                    first + position, ds::NO_INDEX);
+            auto const boarded_stop = timetable.stop_time_stops[first + segment.begin];
+            if (segment.parent == ds::NO_INDEX) {
+                if (segment.walk != ds::NO_INDEX) {
+                    add_leg(boarded_stop, start + timetable.transfer_durations[segment.walk], ds::NO_INDEX,
+                            segment.walk);
+                }
+                break;
+            }
+            // transfers do not keep their footpath, the shortest one between the stops is as fast as the one taken
+            auto const& parent = context.segments[segment.parent];
+            auto const alighted = timetable.trip_stop_times_begin[parent.trip] + segment.alighted;
+            auto const alighted_stop = timetable.stop_time_stops[alighted];
+            if (alighted_stop != boarded_stop) {
+                auto footpath = ds::NO_INDEX;
+                for (auto transfer = timetable.stop_transfers_begin[alighted_stop] ;
+                        transfer < timetable.stop_transfers_begin[alighted_stop + 1] ; ++transfer) {
+                    if (timetable.transfer_targets[transfer] == boarded_stop && (footpath == ds::NO_INDEX
+                            || timetable.transfer_durations[transfer] < timetable.transfer_durations[footpath])) {
+                        footpath = transfer;
+                    }
+                }
+                add_leg(boarded_stop, parent.day * ds::DAY_SECONDS + timetable.stop_time_arrivals[alighted]
+                        + timetable.transfer_durations[footpath], ds::NO_INDEX, footpath);
+            }
+            position = segment.alighted;
+            s = segment.parent;
+        }
+        add_leg(source, start, ds::NO_INDEX, ds::NO_INDEX);
+        std::reverse(legs.begin(), legs.end());
+        return legs;
+    }
+
+    std::vector<ds::date_time_t> trip_based_t::earliest_arrivals(ds::timetable_t const& timetable, uint32_t source,
+            ds::date_time_t const& departure, query_context_t::trip_based_state_t& context) const {
+        auto const query_day = departure.date();
+        search(timetable, source, ds::NO_INDEX, static_cast<int32_t>(query_day.day_number()),
+                ds::seconds_since(query_day, departure), context);
+        std::vector<ds::date_time_t> arrivals(timetable.stop_count(), boost::posix_time::not_a_date_time);
+        for (uint32_t stop = 0 ; stop < arrivals.size() ; ++stop) {
+            if (context.arrivals[stop] != INFINITE_TIME) {
+                arrivals[stop] = ds::to_date_time(query_day, context.arrivals[stop]);
+            }
+        }
+        return arrivals;
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef PLANNER_TRIP_BASED_T_H
+#define PLANNER_TRIP_BASED_T_H
+
+#include "query_context_t.h"
+#include "timetable_t.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace processing {
+
+    // Trip-Based router. Trips are linked by the transfers compiled into the timetable, so a query is a breadth
+    // first search over trip segments: level n holds the parts of trips reached with n transfers, and a trip
+    // reached at some stop cuts the segments of every later trip of its pattern at that stop. Walking between
+    // trips, from the source and to the target takes a single footpath, trip transfers are only compiled for
+    // timetables whose footpaths are transitively closed so it is as fast as any walk.
+    class trip_based_t {
+        struct result_t {
+            data_structures::seconds_t arrival = INFINITE_TIME;
+            uint32_t segment = data_structures::NO_INDEX; // NO_INDEX when walking from the source
+            uint32_t position = 0; // alighted at in the segment
+            uint32_t walk = data_structures::NO_INDEX; // footpath to the target
+        };
+
+        // footpaths by the stop they lead to, walks to the target start at their stops
+        std::vector<uint32_t> incoming_transfers_begin;
+        std::vector<uint32_t> incoming_transfers;
+        std::vector<uint32_t> incoming_transfer_stops;
+        int32_t max_day_span;
+
+        // searches on the context, target may be NO_INDEX to reach every stop. Times are seconds since midnight
+        // of the query day, the segments stay in the context
+        result_t search(data_structures::timetable_t const& timetable, uint32_t source, uint32_t target,
+                int32_t query_day_number, data_structures::seconds_t departure,
+                query_context_t::trip_based_state_t& context) const;
+    public:
+        explicit trip_based_t(data_structures::timetable_t const& timetable);
+
+        std::vector<data_structures::path_leg_t> journey(
+                data_structures::timetable_t const& timetable,
+                uint32_t source,
+                uint32_t target,
+                data_structures::date_time_t const& departure,
+                query_context_t::trip_based_state_t& context) const;
+
+        // earliest arrival at every stop, not_a_date_time for stops that can not be reached
+        std::vector<data_structures::date_time_t> earliest_arrivals(
+                data_structures::timetable_t const& timetable,
+                uint32_t source,
+                data_structures::date_time_t const& departure,
+                query_context_t::trip_based_state_t& context) const;
+    };
+
+}
+
+#endif //PLANNER_TRIP_BASED_T_H
@@ -0,0 +1,334 @@
+#include "trip_transfers.h"
+#include "task_graph_t.h"
+
+#include <algorithm>
+#include <exception>
+#include <limits>
+#include <map>
+#include <tuple>
+
+namespace ds = data_structures;
+
+namespace {
+    constexpr ds::seconds_t UNREACHED = std::numeric_limits<ds::seconds_t>::max();
+    // trips reduced by one task, enough tasks to keep all threads busy
+    constexpr uint32_t CHUNK_TRIPS = 256;
+
+    struct trip_transfer_t {
+        uint32_t from;
+        uint32_t to;
+        int32_t day;
+
+        bool operator<(trip_transfer_t const& that) const {
+            return std::tie(from, to, day) < std::tie(that.from, that.to, that.day);
+        }
+
+        bool operator==(trip_transfer_t const& that) const {
+            return from == that.from && to == that.to && day == that.day;
+        }
+    };
+
+    struct candidate_t {
+        ds::seconds_t departure; // since midnight of the service day of the alighted trip
+        uint32_t trip;
+        int32_t day;
+    };
+
+    // a single footpath between two stops is as fast as any walk when no walk of two footpaths is faster, walks
+    // of more footpaths then shorten to it one footpath after another
+    void check_closed_footpaths(ds::timetable_t const& timetable) {
+        std::vector<ds::seconds_t> direct(timetable.stop_count(), UNREACHED);
+        for (uint32_t from = 0 ; from < timetable.stop_count() ; ++from) {
+            auto const begin = timetable.stop_transfers_begin[from];
+            auto const end = timetable.stop_transfers_begin[from + 1];
+            for (auto transfer = begin ; transfer < end ; ++transfer) {
+                auto& duration = direct[timetable.transfer_targets[transfer]];
+                duration = std::min(duration, timetable.transfer_durations[transfer]);
+            }
+            for (auto first = begin ; first < end ; ++first) {
+                auto const via = timetable.transfer_targets[first];
+                for (auto second = timetable.stop_transfers_begin[via] ;
+                        second < timetable.stop_transfers_begin[via + 1] ; ++second) {
+                    auto const to = timetable.transfer_targets[second];
+                    if (to != from && timetable.transfer_durations[first] + timetable.transfer_durations[second]
+                            < direct[to]) {
+                        throw std::runtime_error("Trip transfers need transitively closed footpaths, walking "
+                                + timetable.stop_ids[from].to_string() + " -> " + timetable.stop_ids[via].to_string()
+                                + " -> " + timetable.stop_ids[to].to_string() + " is faster than any footpath");
+                    }
+                }
+            }
+            for (auto transfer = begin ; transfer < end ; ++transfer) {
+                direct[timetable.transfer_targets[transfer]] = UNREACHED;
+            }
+        }
+    }
+
+    // days a service runs as bits, from the first day of the service the reduced trip runs on
+    struct overlap_t {
+        std::vector<uint64_t> days;
+        uint32_t generation = 0;
+        bool any = false;
+        bool every_day = false; // runs whenever the reduced trip runs
+    };
+
+    // Reduces the transfers of one trip after another. Arrivals are earliest arrivals at stops from the stop
+    // time being reduced on, by staying seated or by one of the transfers kept so far, in seconds since
+    // midnight of the service day of the trip. Calendars differ between trips, so only transfers to trips
+    // running on every day of the reduced trip may lower them
+    class reducer_t {
+        ds::timetable_t const& timetable;
+        int32_t max_day_span;
+        std::vector<ds::seconds_t> arrivals;
+        std::vector<uint32_t> touched;
+        std::vector<candidate_t> candidates;
+        std::vector<uint64_t> uncovered;
+        // days every service shifted by a number of days shares with the service of the reduced trip, by shift
+        // and service. Computed on demand and forgotten when the reduced service changes
+        uint32_t service = ds::NO_INDEX;
+        uint32_t generation = 0;
+        std::vector<overlap_t> overlaps;
+        overlap_t const* own_days = nullptr;
+
+        // bit i is set when the service runs on day number day + i
+        uint64_t service_word(uint32_t other, int32_t day) const {
+            uint64_t word = 0;
+            for (int32_t i = 0 ; i < 64 ; ++i) {
+                if (timetable.is_service_active(other, day + i)) {
+                    word |= uint64_t(1) << i;
+                }
+            }
+            return word;
+        }
+
+        overlap_t const& overlap(uint32_t other, int32_t shift) {
+            auto& entry = overlaps[static_cast<size_t>(shift + max_day_span) * timetable.service_ids.size() + other];
+            if (entry.generation == generation) {
+                return entry;
+            }
+            entry.generation = generation;
+            auto const first_day = timetable.service_first_days[service];
+            auto const length = timetable.service_days_begin[service + 1] - timetable.service_days_begin[service];
+            entry.days.resize((length + 63) / 64);
+            entry.any = false;
+            entry.every_day = true;
+            for (size_t w = 0 ; w < entry.days.size() ; ++w) {
+                auto const day = first_day + static_cast<int32_t>(w * 64);
+                auto const own = service_word(service, day);
+                entry.days[w] = own & service_word(other, day + shift);
+                entry.any = entry.any || entry.days[w] != 0;
+                entry.every_day = entry.every_day && entry.days[w] == own;
+            }
+            return entry;
+        }
+
+        // true when some days of the shared ones are still uncovered, they are covered afterwards
+        bool cover(overlap_t const& shared) {
+            bool covers = false;
+            for (size_t w = 0 ; w < uncovered.size() ; ++w) {
+                covers = covers || (uncovered[w] & shared.days[w]) != 0;
+                uncovered[w] &= ~shared.days[w];
+            }
+            return covers;
+        }
+
+        bool all_covered() const {
+            return std::all_of(uncovered.begin(), uncovered.end(), [](uint64_t word) {
+                return word == 0;
+            });
+        }
+
+        // true when the stop or a stop one footpath away is reached earlier, which is then kept when update
+        bool reach(uint32_t stop, ds::seconds_t time, bool update) {
+            bool improved = false;
+            auto visit = [&](uint32_t to, ds::seconds_t arrival) {
+                if (arrival >= arrivals[to]) {
+                    return;
+                }
+                improved = true;
+                if (update) {
+                    if (arrivals[to] == UNREACHED) {
+                        touched.push_back(to);
+                    }
+                    arrivals[to] = arrival;
+                }
+            };
+            visit(stop, time);
+            for (auto transfer = timetable.stop_transfers_begin[stop] ;
+                    transfer < timetable.stop_transfers_begin[stop + 1] ; ++transfer) {
+                visit(timetable.transfer_targets[transfer], time + timetable.transfer_durations[transfer]);
+            }
+            return improved;
+        }
+
+        // transfers from stop time to the patterns at stop, reachable at time
+        void add_transfers(uint32_t trip, uint32_t stop_time, uint32_t stop, ds::seconds_t time,
+                std::vector<trip_transfer_t>& transfers) {
+            for (auto i = timetable.stop_patterns_begin[stop] ; i < timetable.stop_patterns_begin[stop + 1] ; ++i) {
+                auto const pattern = timetable.stop_patterns[i];
+                auto const position = timetable.stop_pattern_positions[i];
+                auto const trips_begin = timetable.pattern_trips_begin[pattern];
+                auto const width = timetable.pattern_width(pattern);
+                if (position + 1 == width) {
+                    continue;
+                }
+                // departures of the pattern at the stop by rank
+                auto const column = timetable.pattern_departures.cbegin() + timetable.pattern_time(pattern, position, 0);
+                auto const trip_count = timetable.pattern_trip_count(pattern);
+
+                // on every service day the first trips until they run whenever the alighted trip does
+                candidates.clear();
+                auto const today = ds::day_offset(time);
+                for (auto day = today - max_day_span ; day <= today + 1 ; ++day) {
+                    uncovered = own_days->days;
+                    auto const local = time - day * ds::DAY_SECONDS;
+                    auto rank = static_cast<uint32_t>(std::lower_bound(column, column + trip_count, local) - column);
+                    for ( ; rank < trip_count ; ++rank) {
+                        auto const other = timetable.pattern_trips[trips_begin + rank];
+                        if ((other == trip && day == 0) || !cover(overlap(timetable.trip_services[other], day))) {
+                            continue;
+                        }
+                        candidates.push_back(candidate_t{day * ds::DAY_SECONDS + column[rank], other, day});
+                        if (all_covered()) {
+                            break;
+                        }
+                    }
+                }
+                std::sort(candidates.begin(), candidates.end(), [](candidate_t const& l, candidate_t const& r) {
+                    return std::tie(l.departure, l.day, l.trip) < std::tie(r.departure, r.day, r.trip);
+                });
+
+                // a candidate is the earliest trip on the days it runs and no earlier candidate does
+                uncovered = own_days->days;
+                for (auto const& candidate : candidates) {
+                    auto const& shared = overlap(timetable.trip_services[candidate.trip], candidate.day);
+                    if (!cover(shared)) {
+                        continue;
+                    }
+                    auto const begin = timetable.trip_stop_times_begin[candidate.trip];
+                    bool improves = false;
+                    for (auto other = begin + position + 1 ; other < begin + width ; ++other) {
+                        if (reach(timetable.stop_time_stops[other],
+                                candidate.day * ds::DAY_SECONDS + timetable.stop_time_arrivals[other],
+                                shared.every_day)) {
+                            improves = true;
+                        }
+                    }
+                    if (improves) {
+                        transfers.push_back(trip_transfer_t{stop_time, begin + position, candidate.day});
+                    }
+                    if (all_covered()) {
+                        break;
+                    }
+                }
+            }
+        }
+
+    public:
+        // shifts are the service days a trip may be boarded on relative to the day of the trip alighted from
+        reducer_t(ds::timetable_t const& timetable, int32_t max_day_span, int32_t max_shift) : timetable(timetable),
+                max_day_span(max_day_span), arrivals(timetable.stop_count(), UNREACHED),
+                overlaps(static_cast<size_t>(max_day_span + max_shift + 1) * timetable.service_ids.size()) {
+        }
+
+        // stop times are reduced from the last one back, so what later stop times reach is known
+        void reduce(uint32_t trip, std::vector<trip_transfer_t>& transfers) {
+            if (timetable.trip_patterns[trip] == ds::NO_INDEX) {
+                return;
+            }
+            if (timetable.trip_services[trip] != service) {
+                service = timetable.trip_services[trip];
+                ++generation;
+                own_days = &overlap(service, 0);
+            }
+            if (!own_days->any) {
+                return;
+            }
+            auto const begin = timetable.trip_stop_times_begin[trip];
+            for (auto stop_time = timetable.trip_stop_times_begin[trip + 1] - 1 ; stop_time > begin ; --stop_time) {
+                auto const stop = timetable.stop_time_stops[stop_time];
+                auto const arrival = timetable.stop_time_arrivals[stop_time];
+                reach(stop, arrival, true);
+                auto const first = transfers.size();
+                add_transfers(trip, stop_time, stop, arrival, transfers);
+                for (auto transfer = timetable.stop_transfers_begin[stop] ;
+                        transfer < timetable.stop_transfers_begin[stop + 1] ; ++transfer) {
+                    add_transfers(trip, stop_time, timetable.transfer_targets[transfer],
+                            arrival + timetable.transfer_durations[transfer], transfers);
+                }
+                std::sort(transfers.begin() + first, transfers.end());
+                transfers.erase(std::unique(transfers.begin() + first, transfers.end()), transfers.end());
+            }
+            for (auto stop : touched) {
+                arrivals[stop] = UNREACHED;
+            }
+            touched.clear();
+        }
+    };
+}
+
+namespace data_structures {
+
+    trip_transfers_t compute_trip_transfers(timetable_t const& timetable, unsigned threads) {
+        check_closed_footpaths(timetable);
+        int32_t max_day_span = 0;
+        for (auto departure : timetable.stop_time_departures) {
+            max_day_span = std::max(max_day_span, departure / DAY_SECONDS);
+        }
+        // trips are boarded on the day of the arrival after walking or the day after it
+        seconds_t longest_walk = 0;
+        for (auto duration : timetable.transfer_durations) {
+            longest_walk = std::max(longest_walk, duration);
+        }
+        int32_t max_shift = 0;
+        for (auto arrival : timetable.stop_time_arrivals) {
+            max_shift = std::max(max_shift, day_offset(arrival + longest_walk) + 1);
+        }
+
+        auto const trip_count = timetable.trip_count();
+        std::vector<std::vector<trip_transfer_t>> chunks((trip_count + CHUNK_TRIPS - 1) / CHUNK_TRIPS);
+        util::task_graph_t graph;
+        for (uint32_t chunk = 0 ; chunk < chunks.size() ; ++chunk) {
+            graph.add("trip transfers", [&, chunk]() {
+                // trips of a service after another so the reducer keeps its overlaps
+                std::vector<uint32_t> trips;
+                auto const end = std::min(trip_count, (chunk + 1) * CHUNK_TRIPS);
+                for (auto trip = chunk * CHUNK_TRIPS ; trip < end ; ++trip) {
+                    trips.push_back(trip);
+                }
+                std::stable_sort(trips.begin(), trips.end(), [&](uint32_t l, uint32_t r) {
+                    return timetable.trip_services[l] < timetable.trip_services[r];
+                });
+                reducer_t reducer(timetable, max_day_span, max_shift);
+                for (auto trip : trips) {
+                    reducer.reduce(trip, chunks[chunk]);
+                }
+            });
+        }
+        graph.run(std::max(threads, 1u));
+
+        trip_transfers_t result;
+        auto& begins = result.stop_time_transfers_begin;
+        begins.assign(timetable.stop_time_stops.size() + 1, 0);
+        for (auto const& chunk : chunks) {
+            for (auto const& transfer : chunk) {
+                ++begins[transfer.from + 1];
+            }
+        }
+        for (size_t i = 1 ; i < begins.size() ; ++i) {
+            begins[i] += begins[i - 1];
+        }
+        result.stop_times.resize(begins.back());
+        result.days.resize(begins.back());
+        auto fill = begins;
+        for (auto const& chunk : chunks) {
+            for (auto const& transfer : chunk) {
+                auto const i = fill[transfer.from]++;
+                result.stop_times[i] = transfer.to;
+                result.days[i] = static_cast<int8_t>(transfer.day);
+            }
+        }
+        return result;
+    }
+
+}
@@ -0,0 +1,28 @@
+#ifndef PLANNER_TRIP_TRANSFERS_H
+#define PLANNER_TRIP_TRANSFERS_H
+
+#include "timetable_t.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace data_structures {
+
+    // Transfers between trips for the trip based router, grouped by the stop time they alight at. A stop time
+    // only keeps the earliest trip of every pattern it can change to, for every day its trip runs, and of those
+    // only the ones reaching some stop earlier than staying seated or changing at a later stop of the same trip.
+    // Walking between trips takes a single footpath, as fast as any walk in a timetable with transitively closed
+    // footpaths
+    struct trip_transfers_t {
+        std::vector<uint32_t> stop_time_transfers_begin;
+        std::vector<uint32_t> stop_times; // stop time the transfer boards at
+        std::vector<int8_t> days; // service day of the boarded trip relative to the day of the alighted one
+    };
+
+    // trips are reduced in parallel, the result does not depend on threads. Throws when the footpaths are not
+    // transitively closed, some walk of two footpaths would then be faster than any single one
+    trip_transfers_t compute_trip_transfers(timetable_t const& timetable, unsigned threads);
+
+}
+
+#endif //PLANNER_TRIP_TRANSFERS_H